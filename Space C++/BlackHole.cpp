@@ -1,6 +1,6 @@
 #include "BlackHole.h"
 #include "SolarSystem.h"
-#include "UI.h"
+#include "Orbit.h"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <cmath>
@@ -26,7 +26,7 @@ void generateBlackHoles(std::vector<BlackHole>& blackHoles, const BlackHoleConfi
 		smbh.x = 0.0f;
 		smbh.y = 0.0f;
 		smbh.z = 0.0f;
-		smbh.mass = g_currentBlackHoleMass * 1e6f;
+		smbh.mass = config.supermassiveMass * 1e6f;
 
 		float rsKm = calculateSchwarzschildRadius(smbh.mass);
 		smbh.eventHorizonRadius = rsKm * KM_TO_SIM_UNITS * VISUAL_SCALE_FACTOR;
@@ -39,20 +39,49 @@ void generateBlackHoles(std::vector<BlackHole>& blackHoles, const BlackHoleConfi
 	}
 }
 
-void updateBlackHoles(std::vector<BlackHole>& blackHoles, double deltaTime) {
-	for (auto& bh : blackHoles) {
-		bh.diskRotationAngle += bh.diskRotationSpeed * deltaTime;
-		while (bh.diskRotationAngle > 2.0f * M_PI) {
-			bh.diskRotationAngle -= 2.0f * M_PI;
-		}
+void accretionDiskColor(float t, float& r, float& g, float& b) {
+	if (t < 0.12f) {
+		r = 0.4f + t * 2.0f;
+		g = 0.5f + t * 2.5f;
+		b = 1.0f;
+	}
+	else if (t < 0.25f) {
+		float s = (t - 0.12f) / 0.13f;
+		r = 0.65f + s * 0.35f;
+		g = 0.8f + s * 0.2f;
+		b = 1.0f;
+	}
+	else if (t < 0.4f) {
+		r = 1.0f;
+		g = 1.0f;
+		b = 1.0f;
+	}
+	else if (t < 0.6f) {
+		float s = (t - 0.4f) / 0.2f;
+		r = 1.0f;
+		g = 1.0f - s * 0.2f;
+		b = 1.0f - s * 0.6f;
+	}
+	else if (t < 0.8f) {
+		float s = (t - 0.6f) / 0.2f;
+		r = 1.0f;
+		g = 0.8f - s * 0.4f;
+		b = 0.4f - s * 0.3f;
+	}
+	else {
+		float s = (t - 0.8f) / 0.2f;
+		r = 1.0f - s * 0.2f;
+		g = 0.4f - s * 0.25f;
+		b = 0.1f;
 	}
 }
 
-void renderBlackHoles(const std::vector<BlackHole>& blackHoles, const RenderZone& zone) {
+void renderBlackHoles(const std::vector<BlackHole>& blackHoles, double time, const RenderZone& zone) {
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
 
 	for (const auto& bh : blackHoles) {
-		float visualScale = 1.5f;
+		const float diskRotation = rotationAngleAt(bh.diskRotationAngle, bh.diskRotationSpeed, time);
+		float visualScale = BLACK_HOLE_VISUAL_SCALE;
 
 		bool highQuality = false;
 		bool mediumQuality = false;
@@ -108,55 +137,16 @@ void renderBlackHoles(const std::vector<BlackHole>& blackHoles, const RenderZone
 						t2 * (bh.accretionDiskOuterRadius - bh.accretionDiskInnerRadius))
 						* visualScale * layerScale;
 
-					auto getColor = [](float t) -> Color3 {
-						Color3 color;
-						if (t < 0.12f) {
-							color.r = 0.4f + t * 2.0f;
-							color.g = 0.5f + t * 2.5f;
-							color.b = 1.0f;
-						}
-						else if (t < 0.25f) {
-							float s = (t - 0.12f) / 0.13f;
-							color.r = 0.65f + s * 0.35f;
-							color.g = 0.8f + s * 0.2f;
-							color.b = 1.0f;
-						}
-						else if (t < 0.4f) {
-							float s = (t - 0.25f) / 0.15f;
-							color.r = 1.0f;
-							color.g = 1.0f;
-							color.b = 1.0f;
-						}
-						else if (t < 0.6f) {
-							float s = (t - 0.4f) / 0.2f;
-							color.r = 1.0f;
-							color.g = 1.0f - s * 0.2f;
-							color.b = 1.0f - s * 0.6f;
-						}
-						else if (t < 0.8f) {
-							float s = (t - 0.6f) / 0.2f;
-							color.r = 1.0f;
-							color.g = 0.8f - s * 0.4f;
-							color.b = 0.4f - s * 0.3f;
-						}
-						else {
-							float s = (t - 0.8f) / 0.2f;
-							color.r = 1.0f - s * 0.2f;
-							color.g = 0.4f - s * 0.25f;
-							color.b = 0.1f;
-						}
-						return color;
-						};
-
-					Color3 color1 = getColor(t1);
-					Color3 color2 = getColor(t2);
+					Color3 color1, color2;
+					accretionDiskColor(t1, color1.r, color1.g, color1.b);
+					accretionDiskColor(t2, color2.r, color2.g, color2.b);
 
 					float brightness1 = (1.0f - t1 * 0.65f) * layerAlpha * sideAlpha;
 					float brightness2 = (1.0f - t2 * 0.65f) * layerAlpha * sideAlpha;
 
 					glBegin(GL_QUAD_STRIP);
 					for (int i = 0; i <= numSegments; i++) {
-						float angle = (i / (float)numSegments) * 2.0f * (float)M_PI + bh.diskRotationAngle;
+						float angle = (i / (float)numSegments) * 2.0f * (float)M_PI + diskRotation;
 						float cosA = cos(angle);
 						float sinA = sin(angle);
 
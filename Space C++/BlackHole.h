@@ -11,17 +11,22 @@ struct BlackHole {
 	float accretionDiskInnerRadius;
 	float accretionDiskOuterRadius;
 
-	float diskRotationAngle;
+	float diskRotationAngle;	// at time 0
 	float diskRotationSpeed;
 };
 
+// black holes are drawn this much bigger than their radii
+const float BLACK_HOLE_VISUAL_SCALE = 1.5f;
+
 struct BlackHoleConfig {
 	bool enableSupermassive;
+	float supermassiveMass;	// millions of solar masses
 };
 
 void generateBlackHoles(std::vector<BlackHole>& blackHoles, const BlackHoleConfig& config, unsigned int seed, double diskRadius, double bulgeRadius);
-void updateBlackHoles(std::vector<BlackHole>& blackHoles, double deltaTime);
-void renderBlackHoles(const std::vector<BlackHole>& blackHoles, const RenderZone& zone);
+// the accretion disk's colour from its inner edge, t = 0, to its outer edge, t = 1
+void accretionDiskColor(float t, float& r, float& g, float& b);
+void renderBlackHoles(const std::vector<BlackHole>& blackHoles, double time, const RenderZone& zone);
 
 const double SOLAR_MASS_KG = 1.989e30;
 const double SPEED_OF_LIGHT = 2.998e8;
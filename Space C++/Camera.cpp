@@ -4,39 +4,151 @@
 #include <GLFW/glfw3.h>
 #include <cmath>
 
-void setupCamera(const Camera& camera, int width, int height, const SolarSystem& solarSystem) {
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
+void multiplyMatrices(const double* a, const double* b, double* out) {
+	double result[16];
+	for (int col = 0; col < 4; col++) {
+		for (int row = 0; row < 4; row++) {
+			double sum = 0.0;
+			for (int k = 0; k < 4; k++) {
+				sum += a[k * 4 + row] * b[col * 4 + k];
+			}
+			result[col * 4 + row] = sum;
+		}
+	}
+	for (int i = 0; i < 16; i++) out[i] = result[i];
+}
+
+// what glRotated, glTranslated and glScaled multiply the current matrix by
+static void rotationMatrix(double angle, int axis, double* m) {
+	double c = cos(angle), s = sin(angle);
+	int a = (axis + 1) % 3, b = (axis + 2) % 3;
+	for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+	m[a * 4 + a] = c;
+	m[a * 4 + b] = s;
+	m[b * 4 + a] = -s;
+	m[b * 4 + b] = c;
+}
+
+static void translationMatrix(double x, double y, double z, double* m) {
+	for (int i = 0; i < 16; i++) m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+	m[12] = x;
+	m[13] = y;
+	m[14] = z;
+}
+
+static void scaleMatrix(double scale, double* m) {
+	for (int i = 0; i < 16; i++) m[i] = 0.0;
+	m[0] = m[5] = m[10] = scale;
+	m[15] = 1.0;
+}
 
+void cameraMatrices(const Camera& camera, int width, int height, const SolarSystem& solarSystem,
+	double* projection, double* modelview) {
 	double fov = 45.0;
 	double aspect = (double)width / (double)height;
 	double nearPlane = 0.1;
 	double farPlane = 10000.0;
 
 	double f = 1.0 / tan(fov * 0.5 * M_PI / 180.0);
-	double projection[16] = {
+	const double perspective[16] = {
 		f / aspect, 0, 0, 0,
 		0, f, 0, 0,
 		0, 0, (farPlane + nearPlane) / (nearPlane - farPlane), -1,
 		0, 0, (2 * farPlane * nearPlane) / (nearPlane - farPlane), 0
 	};
-	glLoadMatrixd(projection);
+	for (int i = 0; i < 16; i++) projection[i] = perspective[i];
 
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
+	double m[16];
+	rotationMatrix(-camera.pitch, 0, modelview);
+	rotationMatrix(-camera.yaw, 1, m);
+	multiplyMatrices(modelview, m, modelview);
 
-	glRotated(-camera.pitch * 180.0 / M_PI, 1, 0, 0);
-	glRotated(-camera.yaw * 180.0 / M_PI, 0, 1, 0);
-
-	glTranslated(-camera.posX, -camera.posY, -camera.posZ);
+	translationMatrix(-camera.posX, -camera.posY, -camera.posZ, m);
+	multiplyMatrices(modelview, m, modelview);
 
 	if (camera.freeZoomMode) {
-		glTranslated(solarSystem.centerX, solarSystem.centerY, solarSystem.centerZ);
-		glScaled(camera.zoom, camera.zoom, camera.zoom);
-		glTranslated(-solarSystem.centerX, -solarSystem.centerY, -solarSystem.centerZ);
+		translationMatrix(solarSystem.centerX, solarSystem.centerY, solarSystem.centerZ, m);
+		multiplyMatrices(modelview, m, modelview);
+		scaleMatrix(camera.zoom, m);
+		multiplyMatrices(modelview, m, modelview);
+		translationMatrix(-solarSystem.centerX, -solarSystem.centerY, -solarSystem.centerZ, m);
+		multiplyMatrices(modelview, m, modelview);
 	} else {
-		glScaled(camera.zoom, camera.zoom, camera.zoom);
+		scaleMatrix(camera.zoom, m);
+		multiplyMatrices(modelview, m, modelview);
+	}
+}
+
+void setupCamera(const Camera& camera, int width, int height, const SolarSystem& solarSystem) {
+	double projection[16], modelview[16];
+	cameraMatrices(camera, width, height, solarSystem, projection, modelview);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixd(projection);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixd(modelview);
+}
+
+ViewFrustum viewFrustumFromMatrices(const double* projection, const double* modelview, int viewportHeight) {
+	// clip = projection * modelview
+	double clip[16];
+	multiplyMatrices(projection, modelview, clip);
+
+	// a point is inside where -w <= x, y, z <= w in clip space, each side is the w row
+	// plus or minus one of the others
+	ViewFrustum frustum;
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = 0; side < 2; side++) {
+			double sign = side == 0 ? 1.0 : -1.0;
+			double* plane = frustum.planes[axis * 2 + side];
+			for (int col = 0; col < 4; col++) {
+				plane[col] = clip[col * 4 + 3] + sign * clip[col * 4 + axis];
+			}
+
+			// normalised, so plane distances are world units
+			double length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length > 0.0) {
+				for (int i = 0; i < 4; i++) plane[i] /= length;
+			}
+		}
+	}
+
+	// the camera is where the modelview takes the origin, so it is the inverse of the translation.
+	// The 3x3 part is rotation times the zoom scale, inverted by cofactors
+	const double* m = modelview;
+	double det = m[0] * (m[5] * m[10] - m[9] * m[6]) - m[4] * (m[1] * m[10] - m[9] * m[2]) +
+		m[8] * (m[1] * m[6] - m[5] * m[2]);
+	double inverse[9] = {
+		(m[5] * m[10] - m[9] * m[6]), -(m[4] * m[10] - m[8] * m[6]), (m[4] * m[9] - m[8] * m[5]),
+		-(m[1] * m[10] - m[9] * m[2]), (m[0] * m[10] - m[8] * m[2]), -(m[0] * m[9] - m[8] * m[1]),
+		(m[1] * m[6] - m[5] * m[2]), -(m[0] * m[6] - m[4] * m[2]), (m[0] * m[5] - m[4] * m[1])
+	};
+	for (int row = 0; row < 3; row++) {
+		frustum.eye[row] = -(inverse[row * 3 + 0] * m[12] + inverse[row * 3 + 1] * m[13] +
+			inverse[row * 3 + 2] * m[14]) / det;
+	}
+
+	// the zoom scales sizes and distances alike, so only the projection and viewport count
+	frustum.pixelScale = projection[5] * viewportHeight * 0.5;
+	return frustum;
+}
+
+ViewFrustum currentViewFrustum() {
+	double projection[16], modelview[16];
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	return viewFrustumFromMatrices(projection, modelview, viewport[3]);
+}
+
+bool sphereInFrustum(const ViewFrustum& frustum, double x, double y, double z, double radius) {
+	for (int p = 0; p < 6; p++) {
+		const double* plane = frustum.planes[p];
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -radius) return false;
 	}
+	return true;
 }
 
 void processInput(GLFWwindow* window, Camera& camera, const UIState* uiState) {
@@ -14,8 +14,26 @@ struct Camera {
     bool freeZoomMode = false;
 };
 
+// The view volume as six planes in world space, a*x + b*y + c*z + d >= 0 on the inside,
+// so anything that is outside one of them can't be seen
+struct ViewFrustum {
+    double planes[6][4];
+    double eye[3];          // the camera in world space
+    double pixelScale;      // pixels a world unit covers one world unit in front of the camera
+};
+
 struct SolarSystem;
 struct UIState;
 
+// out = a * b, 4x4 and column-major like GL's; out may be a or b
+void multiplyMatrices(const double* a, const double* b, double* out);
+// the projection and modelview matrices setupCamera loads, column-major like GL's
+void cameraMatrices(const Camera& camera, int width, int height, const SolarSystem& solarSystem,
+    double* projection, double* modelview);
 void setupCamera(const Camera& camera, int width, int height, const SolarSystem& solarSystem);
 void processInput(struct GLFWwindow* window, Camera& camera, const UIState* uiState = nullptr);
+// the frustum of the projection and modelview matrices setupCamera left in the GL state
+ViewFrustum currentViewFrustum();
+ViewFrustum viewFrustumFromMatrices(const double* projection, const double* modelview, int viewportHeight);
+// false only if the sphere is wholly outside the frustum
+bool sphereInFrustum(const ViewFrustum& frustum, double x, double y, double z, double radius);
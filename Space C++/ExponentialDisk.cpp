@@ -0,0 +1,72 @@
+#include "ExponentialDisk.h"
+#include <vector>
+#include <cmath>
+
+// number of intervals in the tabulated inverse CDF
+const int INVERSE_CDF_SIZE = 4096;
+
+double exponentialDiskCDF(double t) {
+	return 1.0 - (1.0 + t) * std::exp(-t);
+}
+
+// Solves F(t) = u with Newton, written against the tail 1 - F so it stays accurate near u = 1
+static double solveExponentialDisk(double u, double t) {
+	for (int it = 0; it < 50; ++it) {
+		double expNegT = std::exp(-t);
+		double G = (1.0 - u) - (1.0 + t) * expNegT;	// F(t) - u
+		double dFdt = t * expNegT;
+
+		if (std::fabs(G) < 1e-15 || dFdt <= 1e-300) break;
+		double next = t - G / dFdt;
+		t = (next > 0.0) ? next : t * 0.5;
+	}
+	return t;
+}
+
+double solveExponentialDiskCDF(double u) {
+	if (u <= 0.0) return 0.0;
+	return solveExponentialDisk(u, std::sqrt(2.0 * u));
+}
+
+static std::vector<float> buildInverseCDF() {
+	std::vector<float> table(INVERSE_CDF_SIZE + 1);
+
+	double t = 0.0;
+	table[0] = 0.0f;
+	for (int i = 1; i < INVERSE_CDF_SIZE; i++) {
+		double u = i / (double)INVERSE_CDF_SIZE;
+		// near 0, F(t) ~ t^2 / 2
+		t = solveExponentialDisk(u, (t > 0.0) ? t : std::sqrt(2.0 * u));
+		table[i] = static_cast<float>(t);
+	}
+	// u = 1 is infinite, the last interval is solved per sample instead
+	table[INVERSE_CDF_SIZE] = table[INVERSE_CDF_SIZE - 1];
+
+	return table;
+}
+
+static const std::vector<float>& inverseCDF() {
+	static const std::vector<float> table = buildInverseCDF();
+	return table;
+}
+
+float ExponentialDiskSampler::sample(float u) const {
+	const std::vector<float>& table = inverseCDF();
+
+	float x = u * INVERSE_CDF_SIZE;
+	int i = static_cast<int>(x);
+	if (i < 0) return 0.0f;
+
+	if (i >= INVERSE_CDF_SIZE - 1) {
+		// the far tail is too steep to interpolate
+		return static_cast<float>(solveExponentialDisk(u, table[INVERSE_CDF_SIZE - 1])) * diskScale;
+	}
+
+	float f = x - i;
+	return (table[i] + (table[i + 1] - table[i]) * f) * diskScale;
+}
+
+ExponentialDiskSampler makeExponentialDiskSampler(float diskScale) {
+	inverseCDF(); // build the shared table up front rather than on a worker thread
+	return ExponentialDiskSampler{ diskScale };
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Exponential disk radial profile.
+// Surface density Sigma(r) ∝ exp(-r/rd), so radii follow the PDF r * exp(-r/rd) / rd^2
+// CDF: F(r) = 1 - (1 + r/rd) * exp(-r/rd)
+
+// CDF of the profile in units of the disk scale (t = r / rd)
+double exponentialDiskCDF(double t);
+// its inverse solved with Newton to full precision, what the sampler's table is built from
+double solveExponentialDiskCDF(double u);
+
+// Inverse CDF sampler. The profile is scale-free, so one table tabulated for rd = 1
+// is shared by every disk and just scaled by diskScale on lookup.
+struct ExponentialDiskSampler {
+	float diskScale;
+
+	// maps a uniform u in [0, 1) to a radius
+	float sample(float u) const;
+};
+
+ExponentialDiskSampler makeExponentialDiskSampler(float diskScale);
@@ -0,0 +1,151 @@
+#include "FrameCapture.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// captured frames may wait on the writer, the rest are dropped; with the frames being read
+// and those being encoded it takes most of the ring
+const size_t CAPTURE_QUEUED_FRAMES = 3;
+// frames between reading a buffer and mapping it, the GPU has finished the copy by then
+const int CAPTURE_MAP_DELAY = 2;
+// a fence this old has signalled unless the GPU has hung
+const GLuint64 CAPTURE_FENCE_TIMEOUT_NS = 1000000000ull;
+
+static void createBuffers(FrameCapture& capture, int width, int height) {
+	capture.width = width;
+	capture.height = height;
+
+	glGenBuffers(CAPTURE_RING_SIZE, capture.buffers);
+	for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// maps buffer i once its read has finished and hands it to the writer, if it has room
+static void collectBuffer(FrameCapture& capture, int i) {
+	GLenum status = glClientWaitSync(capture.fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_FENCE_TIMEOUT_NS);
+	glDeleteSync(capture.fences[i]);
+	capture.fences[i] = nullptr;
+	if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+		std::cerr << "Capture of frame " << capture.bufferFrames[i] << " timed out" << std::endl;
+		return;
+	}
+
+	// only the render thread queues, so the room can't go before the frame is queued
+	if (!frameWriterHasRoom(capture.writer)) {
+		capture.framesDropped++;
+		return;
+	}
+
+	const size_t size = static_cast<size_t>(capture.width) * capture.height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[i]);
+	const uint8_t* pixels = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!pixels) return;
+
+	capture.mapped[i] = true;
+	queueBorrowedFrame(capture.writer, frameFileName(capture.pattern, capture.bufferFrames[i]), pixels,
+		capture.released[i], capture.width, capture.height, true);
+}
+
+// unmaps the buffers the writer has finished with
+static void reclaimBuffers(FrameCapture& capture) {
+	for (int i = 0; i < CAPTURE_RING_SIZE; i++) {
+		if (!capture.mapped[i] || !capture.released[i].load()) continue;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[i]);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		capture.mapped[i] = false;
+	}
+}
+
+// hands on every buffer still being read into, oldest first, waits for the writer and frees them
+static void releaseBuffers(FrameCapture& capture) {
+	for (int k = 0; k < CAPTURE_RING_SIZE; k++) {
+		int i = (capture.nextBuffer + k) % CAPTURE_RING_SIZE;
+		if (capture.fences[i]) collectBuffer(capture, i);
+	}
+	flushFrameWriter(capture.writer);
+	reclaimBuffers(capture);
+
+	if (capture.buffers[0]) glDeleteBuffers(CAPTURE_RING_SIZE, capture.buffers);
+	for (int i = 0; i < CAPTURE_RING_SIZE; i++) capture.buffers[i] = 0;
+	capture.nextBuffer = 0;
+	capture.width = capture.height = 0;
+}
+
+bool startFrameCapture(FrameCapture& capture, const std::string& pattern) {
+	if (capture.active) return true;
+
+	if (!glPixelPackBufferSupported() || !glBufferMappingSupported()) {
+		std::cerr << "Capture needs pixel buffer objects and fences (OpenGL 3.2)" << std::endl;
+		return false;
+	}
+
+	capture.pattern = pattern;
+	capture.framesRead = capture.framesDropped = 0;
+	capture.readMilliseconds = 0.0;
+	capture.writer.framesWritten = capture.writer.framesFailed = 0;
+	capture.writer.encodeMilliseconds = 0.0;
+	startFrameWriter(capture.writer, 0, CAPTURE_QUEUED_FRAMES);
+	capture.active = true;
+
+	std::cout << "Capturing to " << frameFileName(pattern, capture.nextFrame) << std::endl;
+	return true;
+}
+
+void stopFrameCapture(FrameCapture& capture) {
+	if (!capture.active) return;
+
+	releaseBuffers(capture);
+	stopFrameWriter(capture.writer);
+	capture.active = false;
+
+	const FrameWriter& writer = capture.writer;
+	std::cout << "Captured " << writer.framesWritten << " frames";
+	if (capture.framesRead > 0) {
+		std::cout << ", " << capture.readMilliseconds / capture.framesRead << " ms per frame on the render thread";
+	}
+	if (capture.framesDropped > 0) std::cout << ", " << capture.framesDropped << " dropped as the writer fell behind";
+	if (writer.framesFailed > 0) std::cout << ", " << writer.framesFailed << " could not be written";
+	std::cout << std::endl;
+}
+
+void captureFrame(FrameCapture& capture, int width, int height) {
+	if (!capture.active || width <= 0 || height <= 0) return;
+	auto start = std::chrono::steady_clock::now();
+
+	if (width != capture.width || height != capture.height) {
+		releaseBuffers(capture);
+		createBuffers(capture, width, height);
+	}
+
+	reclaimBuffers(capture);
+	int collect = (capture.nextBuffer + CAPTURE_RING_SIZE - CAPTURE_MAP_DELAY) % CAPTURE_RING_SIZE;
+	if (capture.fences[collect]) collectBuffer(capture, collect);
+
+	// a buffer the writer still has means it is behind, this frame goes
+	int i = capture.nextBuffer;
+	if (capture.mapped[i]) {
+		capture.framesDropped++;
+		capture.nextFrame++;
+		capture.readMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	// BGRA is what the framebuffer holds on most hardware, so the GPU copies it as it is
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffers[i]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadBuffer(GL_BACK);
+	glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	capture.fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	capture.bufferFrames[i] = capture.nextFrame++;
+	capture.nextBuffer = (i + 1) % CAPTURE_RING_SIZE;
+
+	capture.framesRead++;
+	capture.readMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "GLExtensions.h"
+#include "FrameWriter.h"
+#include <string>
+
+// Records the window to a PNG sequence while it runs.
+//
+// A plain glReadPixels waits for the GPU to finish the frame and then copies it, which costs
+// the render thread several milliseconds at 1080p. Here each frame is read into one of a
+// ring of pixel pack buffers instead, which queues the copy on the GPU and returns at once,
+// and a fence marks when it is done. A couple of frames later, by when the copy has long
+// finished, the buffer is mapped and the pointer handed to a FrameWriter, whose threads read,
+// convert, encode and write it; it stays mapped until they are done and is unmapped when the
+// render thread next finds it released. The render thread never touches the pixels. If the
+// writer falls behind, frames are dropped, before mapping, rather than holding up the window.
+
+const int CAPTURE_RING_SIZE = 6;
+
+struct FrameCapture {
+	bool active = false;
+	std::string pattern;		// file names, see frameFileName
+	int width = 0, height = 0;
+
+	GLuint buffers[CAPTURE_RING_SIZE] = {};
+	GLsync fences[CAPTURE_RING_SIZE] = {};			// being read into
+	bool mapped[CAPTURE_RING_SIZE] = {};			// handed to the writer
+	std::atomic<bool> released[CAPTURE_RING_SIZE] = {};	// the writer is done with it
+	int bufferFrames[CAPTURE_RING_SIZE] = {};	// frame number read into each buffer
+	int nextBuffer = 0;
+	int nextFrame = 0;			// carries on over stops, so a new capture doesn't overwrite files
+
+	FrameWriter writer;
+
+	int framesRead = 0;
+	int framesDropped = 0;
+	double readMilliseconds = 0.0;		// render thread time spent on capturing
+};
+
+// false, after printing why, if the context can't read back asynchronously
+bool startFrameCapture(FrameCapture& capture, const std::string& pattern);
+// hands on the frames still in flight and waits for them to be written
+void stopFrameCapture(FrameCapture& capture);
+
+// call once the frame is drawn, before glfwSwapBuffers; reads the back buffer
+void captureFrame(FrameCapture& capture, int width, int height);
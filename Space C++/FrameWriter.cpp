@@ -0,0 +1,173 @@
+#include "FrameWriter.h"
+#include "PngWriter.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// frames each thread may have waiting behind the one it is encoding
+const size_t QUEUED_FRAMES_PER_THREAD = 2;
+
+// BGRA rows bottom to top into RGB rows top to bottom
+static void convertGLReadback(const uint8_t* bgra, int width, int height, std::vector<uint8_t>& rgb) {
+	rgb.resize(static_cast<size_t>(width) * height * 3);
+	for (int y = 0; y < height; y++) {
+		const uint8_t* in = &bgra[static_cast<size_t>(height - 1 - y) * width * 4];
+		uint8_t* out = &rgb[static_cast<size_t>(y) * width * 3];
+		for (int x = 0; x < width; x++) {
+			out[x * 3 + 0] = in[x * 4 + 2];
+			out[x * 3 + 1] = in[x * 4 + 1];
+			out[x * 3 + 2] = in[x * 4 + 0];
+		}
+	}
+}
+
+static void writerLoop(FrameWriter& writer) {
+	std::vector<uint8_t> converted;
+
+	std::unique_lock<std::mutex> lock(writer.mutex);
+	while (true) {
+		writer.frameQueued.wait(lock, [&writer]() { return writer.stopping || !writer.queue.empty(); });
+		if (writer.queue.empty()) return;	// stopping, and everything is written
+
+		QueuedFrame frame = std::move(writer.queue.front());
+		writer.queue.pop_front();
+		writer.framesEncoding++;
+		writer.frameTaken.notify_one();
+
+		lock.unlock();
+		auto start = std::chrono::steady_clock::now();
+		const uint8_t* rgb = frame.borrowed ? frame.borrowed : frame.rgb.data();
+		if (frame.glReadback) {
+			convertGLReadback(rgb, frame.width, frame.height, converted);
+			rgb = converted.data();
+		}
+		// once converted the caller can have its memory back before the encode
+		if (frame.borrowed && frame.glReadback) frame.released->store(true);
+		bool written = writePNG(frame.path, rgb, frame.width, frame.height);
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (frame.borrowed && !frame.glReadback) frame.released->store(true);
+		lock.lock();
+
+		if (written) writer.framesWritten++;
+		else writer.framesFailed++;
+		writer.encodeMilliseconds += milliseconds;
+		if (!frame.borrowed) writer.spareBuffers.push_back(std::move(frame.rgb));
+		writer.framesEncoding--;
+		writer.frameWritten.notify_all();
+	}
+}
+
+void startFrameWriter(FrameWriter& writer, int numThreads, size_t maxQueued) {
+	if (numThreads <= 0) {
+		numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 4);
+	}
+	writer.maxQueued = maxQueued > 0 ? maxQueued : numThreads * QUEUED_FRAMES_PER_THREAD;
+
+	for (int t = 0; t < numThreads; t++) {
+		writer.threads.emplace_back(writerLoop, std::ref(writer));
+	}
+}
+
+void stopFrameWriter(FrameWriter& writer) {
+	{
+		std::lock_guard<std::mutex> lock(writer.mutex);
+		writer.stopping = true;
+	}
+	writer.frameQueued.notify_all();
+
+	for (auto& thread : writer.threads) {
+		thread.join();
+	}
+	writer.threads.clear();
+	writer.spareBuffers.clear();
+	writer.stopping = false;
+}
+
+void flushFrameWriter(FrameWriter& writer) {
+	std::unique_lock<std::mutex> lock(writer.mutex);
+	writer.frameWritten.wait(lock, [&writer]() { return writer.queue.empty() && writer.framesEncoding == 0; });
+}
+
+int frameWriterSize(const FrameWriter& writer) {
+	return static_cast<int>(writer.threads.size());
+}
+
+bool queueFrame(FrameWriter& writer, const std::string& path, std::vector<uint8_t>& rgb,
+	int width, int height, bool glReadback, bool waitIfFull) {
+	std::unique_lock<std::mutex> lock(writer.mutex);
+	if (waitIfFull) {
+		writer.frameTaken.wait(lock, [&writer]() { return writer.queue.size() < writer.maxQueued; });
+	}
+	else if (writer.queue.size() >= writer.maxQueued) {
+		writer.framesDropped++;
+		return false;
+	}
+
+	QueuedFrame frame;
+	frame.path = path;
+	frame.borrowed = nullptr;
+	frame.released = nullptr;
+	frame.width = width;
+	frame.height = height;
+	frame.glReadback = glReadback;
+	frame.rgb.swap(rgb);
+	writer.queue.push_back(std::move(frame));
+	if (!writer.spareBuffers.empty()) {
+		rgb.swap(writer.spareBuffers.back());
+		writer.spareBuffers.pop_back();
+	}
+	lock.unlock();
+
+	writer.frameQueued.notify_one();
+	return true;
+}
+
+bool frameWriterHasRoom(FrameWriter& writer) {
+	std::lock_guard<std::mutex> lock(writer.mutex);
+	return writer.queue.size() < writer.maxQueued;
+}
+
+void queueBorrowedFrame(FrameWriter& writer, const std::string& path, const uint8_t* pixels,
+	std::atomic<bool>& released, int width, int height, bool glReadback) {
+	released.store(false);
+
+	std::unique_lock<std::mutex> lock(writer.mutex);
+	writer.frameTaken.wait(lock, [&writer]() { return writer.queue.size() < writer.maxQueued; });
+
+	QueuedFrame frame;
+	frame.path = path;
+	frame.borrowed = pixels;
+	frame.released = &released;
+	frame.width = width;
+	frame.height = height;
+	frame.glReadback = glReadback;
+	writer.queue.push_back(std::move(frame));
+	lock.unlock();
+
+	writer.frameQueued.notify_one();
+}
+
+std::string frameFileName(const std::string& pattern, int frame) {
+	size_t percent = pattern.find('%');
+	size_t end = percent;
+	if (percent != std::string::npos) {
+		end = percent + 1;
+		while (end < pattern.size() && isdigit(static_cast<unsigned char>(pattern[end]))) end++;
+		if (end >= pattern.size() || pattern[end] != 'd') end = std::string::npos;
+	}
+
+	char number[32];
+	if (end == std::string::npos) {
+		snprintf(number, sizeof(number), "_%05d", frame);
+		size_t dot = pattern.find_last_of('.');
+		size_t slash = pattern.find_last_of("/\\");
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return pattern + number;
+		return pattern.substr(0, dot) + number + pattern.substr(dot);
+	}
+
+	int width = atoi(pattern.substr(percent + 1, end - percent - 1).c_str());
+	snprintf(number, sizeof(number), "%0*d", std::min(width, 20), frame);
+	return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// Threads that encode frames to PNG files while the next frames are being made.
+//
+// queueFrame hands a frame over and returns straight away, unless maxQueued frames are
+// already waiting, then it waits for one to be taken so a fast renderer can't pile up
+// frames faster than the disk takes them (or, for live capture, drops the frame instead).
+// The pixel buffers are handed back and forth rather than copied or reallocated: the
+// caller gets an encoded frame's buffer in return. Or the writer can read a frame from
+// memory the caller keeps, such as a mapped buffer object, and flag when it is done with it.
+
+struct QueuedFrame {
+	std::string path;
+	std::vector<uint8_t> rgb;
+	const uint8_t* borrowed;		// the pixels in place of rgb, if not null
+	std::atomic<bool>* released;	// set once borrowed has been read
+	int width, height;
+	bool glReadback;	// BGRA with rows bottom to top, as glReadPixels gives them fastest
+};
+
+struct FrameWriter {
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable frameQueued;	// a frame was queued or the writer is stopping
+	std::condition_variable frameTaken;		// a thread took a frame off the queue
+	std::condition_variable frameWritten;	// a thread finished a frame
+	std::deque<QueuedFrame> queue;
+	std::vector<std::vector<uint8_t>> spareBuffers;
+	size_t maxQueued = 0;
+	int framesEncoding = 0;
+	bool stopping = false;
+
+	int framesWritten = 0;
+	int framesFailed = 0;
+	int framesDropped = 0;
+	double encodeMilliseconds = 0.0;	// summed over the threads
+};
+
+// numThreads 0 = a quarter of the cores, at least one
+void startFrameWriter(FrameWriter& writer, int numThreads = 0, size_t maxQueued = 0);
+// writes what is still queued, then stops the threads
+void stopFrameWriter(FrameWriter& writer);
+// waits for what is queued to be written, the threads carry on
+void flushFrameWriter(FrameWriter& writer);
+
+int frameWriterSize(const FrameWriter& writer);
+
+// rgb is width * height * 3 bytes, rows top to bottom, or with glReadback set width * height * 4
+// as GL reads them back. It is swapped for a spare buffer, empty if there is none.
+// With waitIfFull false a frame that doesn't fit is dropped, returning false with rgb untouched
+bool queueFrame(FrameWriter& writer, const std::string& path, std::vector<uint8_t>& rgb,
+	int width, int height, bool glReadback = false, bool waitIfFull = true);
+
+// whether a frame queued now would be taken without waiting
+bool frameWriterHasRoom(FrameWriter& writer);
+// pixels as for queueFrame, but left where they are until the writer sets released; waits if full
+void queueBorrowedFrame(FrameWriter& writer, const std::string& path, const uint8_t* pixels,
+	std::atomic<bool>& released, int width, int height, bool glReadback = false);
+
+// frame n of a sequence: pattern has one %d in it, optionally with a zero-padded width,
+// or else gets _%05d before its extension
+std::string frameFileName(const std::string& pattern, int frame);
@@ -0,0 +1,160 @@
+#include "GLExtensions.h"
+#include <iostream>
+#include <cstdio>
+#include <vector>
+
+#define DEFINE_GL_EXTENSION_FUNCTION(ret, name, params) \
+	PFN_gl##name glext_##name = nullptr;
+GL_EXTENSION_FUNCTIONS(DEFINE_GL_EXTENSION_FUNCTION)
+GL_BUFFER_MAPPING_FUNCTIONS(DEFINE_GL_EXTENSION_FUNCTION)
+GL_BUFFER_STORAGE_FUNCTIONS(DEFINE_GL_EXTENSION_FUNCTION)
+GL_INSTANCING_FUNCTIONS(DEFINE_GL_EXTENSION_FUNCTION)
+GL_FRAMEBUFFER_FUNCTIONS(DEFINE_GL_EXTENSION_FUNCTION)
+#undef DEFINE_GL_EXTENSION_FUNCTION
+
+static bool extensionsLoaded = false;
+static bool bufferMappingSupported = false;
+static bool bufferStorageSupported = false;
+static bool pixelPackBufferSupported = false;
+static bool instancingSupported = false;
+static bool framebufferSupported = false;
+
+// true if the context is at least major.minor
+static bool glVersionAtLeast(int major, int minor) {
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+	int contextMajor = 0, contextMinor = 0;
+	if (!version || sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2) return false;
+	return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+bool loadGLExtensions() {
+	bool complete = true;
+
+#define LOAD_GL_EXTENSION_FUNCTION(ret, name, params) \
+	glext_##name = reinterpret_cast<PFN_gl##name>(glfwGetProcAddress("gl" #name)); \
+	if (!glext_##name) { \
+		std::cerr << "Missing OpenGL function gl" #name << std::endl; \
+		complete = false; \
+	}
+	GL_EXTENSION_FUNCTIONS(LOAD_GL_EXTENSION_FUNCTION)
+#undef LOAD_GL_EXTENSION_FUNCTION
+
+	extensionsLoaded = complete;
+
+	// the lookup alone proves nothing here, some drivers hand out entry points they don't back
+	bufferMappingSupported = complete && (glVersionAtLeast(3, 2) ||
+		(glfwExtensionSupported("GL_ARB_map_buffer_range") && glfwExtensionSupported("GL_ARB_sync")));
+	bufferStorageSupported = bufferMappingSupported &&
+		(glVersionAtLeast(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage"));
+	pixelPackBufferSupported = complete &&
+		(glVersionAtLeast(2, 1) || glfwExtensionSupported("GL_ARB_pixel_buffer_object"));
+	instancingSupported = complete && (glVersionAtLeast(3, 3) ||
+		(glfwExtensionSupported("GL_ARB_draw_instanced") && glfwExtensionSupported("GL_ARB_instanced_arrays")));
+	framebufferSupported = complete && (glVersionAtLeast(3, 0) ||
+		(glfwExtensionSupported("GL_ARB_framebuffer_object") && glfwExtensionSupported("GL_ARB_texture_float")));
+
+#define LOAD_OPTIONAL_GL_EXTENSION_FUNCTION(ret, name, params) \
+	glext_##name = reinterpret_cast<PFN_gl##name>(glfwGetProcAddress("gl" #name)); \
+	if (!glext_##name) supported = false;
+	bool supported = bufferMappingSupported;
+	GL_BUFFER_MAPPING_FUNCTIONS(LOAD_OPTIONAL_GL_EXTENSION_FUNCTION)
+	bufferMappingSupported = supported;
+
+	supported = bufferStorageSupported && bufferMappingSupported;
+	GL_BUFFER_STORAGE_FUNCTIONS(LOAD_OPTIONAL_GL_EXTENSION_FUNCTION)
+	bufferStorageSupported = supported;
+
+	supported = instancingSupported;
+	GL_INSTANCING_FUNCTIONS(LOAD_OPTIONAL_GL_EXTENSION_FUNCTION)
+	instancingSupported = supported;
+
+	supported = framebufferSupported;
+	GL_FRAMEBUFFER_FUNCTIONS(LOAD_OPTIONAL_GL_EXTENSION_FUNCTION)
+	framebufferSupported = supported;
+#undef LOAD_OPTIONAL_GL_EXTENSION_FUNCTION
+
+	return complete;
+}
+
+bool glExtensionsLoaded() {
+	return extensionsLoaded;
+}
+
+bool glBufferMappingSupported() {
+	return bufferMappingSupported;
+}
+
+bool glBufferStorageSupported() {
+	return bufferStorageSupported;
+}
+
+bool glInstancingSupported() {
+	return instancingSupported;
+}
+
+bool glFramebufferSupported() {
+	return framebufferSupported;
+}
+
+bool glPixelPackBufferSupported() {
+	return pixelPackBufferSupported;
+}
+
+static GLuint compileShader(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint logLength = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<GLchar> log(logLength + 1, 0);
+		glGetShaderInfoLog(shader, logLength, nullptr, log.data());
+		std::cerr << "Shader compile failed: " << log.data() << std::endl;
+
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource,
+	const char* const* attributes, int numAttributes) {
+	if (!extensionsLoaded) return 0;
+
+	GLuint vertexShader = vertexSource ? compileShader(GL_VERTEX_SHADER, vertexSource) : 0;
+	GLuint fragmentShader = fragmentSource ? compileShader(GL_FRAGMENT_SHADER, fragmentSource) : 0;
+	if ((vertexSource && !vertexShader) || (fragmentSource && !fragmentShader)) {
+		if (vertexShader) glDeleteShader(vertexShader);
+		if (fragmentShader) glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	if (vertexShader) glAttachShader(program, vertexShader);
+	if (fragmentShader) glAttachShader(program, fragmentShader);
+	for (int i = 0; i < numAttributes; i++) {
+		glBindAttribLocation(program, i, attributes[i]);
+	}
+	glLinkProgram(program);
+
+	// the program keeps what it needs, the shaders are only flagged for deletion while attached
+	if (vertexShader) glDeleteShader(vertexShader);
+	if (fragmentShader) glDeleteShader(fragmentShader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE) {
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<GLchar> log(logLength + 1, 0);
+		glGetProgramInfoLog(program, logLength, nullptr, log.data());
+		std::cerr << "Shader link failed: " << log.data() << std::endl;
+
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <cstdint>
+
+// Entry points past OpenGL 1.1, which is all the system headers and libraries promise on Windows.
+// They are looked up through GLFW once a context is current; call loadGLExtensions after
+// creating the window and only use them if it returned true. The optional ones are newer
+// than that and may be missing even then; each group has its own check.
+
+#ifndef GL_VERSION_1_5
+#define GL_VERSION_1_5 1
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STREAM_DRAW 0x88E0
+#define GL_STREAM_READ 0x88E1
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+#ifndef GL_VERSION_2_0
+#define GL_VERSION_2_0 1
+typedef char GLchar;
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+
+#ifndef GL_VERSION_2_1
+#define GL_VERSION_2_1 1
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+
+#ifndef GL_VERSION_3_0
+#define GL_VERSION_3_0 1
+#define GL_MAP_READ_BIT 0x0001
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_RGBA16F 0x881A
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+
+#ifndef GL_VERSION_3_2
+#define GL_VERSION_3_2 1
+typedef struct __GLsync* GLsync;
+typedef uint64_t GLuint64;
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_VERSION_4_4 1
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// return type, name without the gl prefix, parameters
+#define GL_EXTENSION_FUNCTIONS(X) \
+	X(void, GenBuffers, (GLsizei n, GLuint* buffers)) \
+	X(void, DeleteBuffers, (GLsizei n, const GLuint* buffers)) \
+	X(void, BindBuffer, (GLenum target, GLuint buffer)) \
+	X(void, BufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage)) \
+	X(void, BufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data)) \
+	X(GLuint, CreateShader, (GLenum type)) \
+	X(void, DeleteShader, (GLuint shader)) \
+	X(void, ShaderSource, (GLuint shader, GLsizei count, const GLchar* const* source, const GLint* length)) \
+	X(void, CompileShader, (GLuint shader)) \
+	X(void, GetShaderiv, (GLuint shader, GLenum pname, GLint* params)) \
+	X(void, GetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+	X(GLuint, CreateProgram, (void)) \
+	X(void, DeleteProgram, (GLuint program)) \
+	X(void, AttachShader, (GLuint program, GLuint shader)) \
+	X(void, BindAttribLocation, (GLuint program, GLuint index, const GLchar* name)) \
+	X(void, LinkProgram, (GLuint program)) \
+	X(void, GetProgramiv, (GLuint program, GLenum pname, GLint* params)) \
+	X(void, GetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog)) \
+	X(void, UseProgram, (GLuint program)) \
+	X(GLint, GetUniformLocation, (GLuint program, const GLchar* name)) \
+	X(void, Uniform1f, (GLint location, GLfloat v0)) \
+	X(void, Uniform3fv, (GLint location, GLsizei count, const GLfloat* value)) \
+	X(void, VertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, \
+		GLsizei stride, const void* pointer)) \
+	X(void, EnableVertexAttribArray, (GLuint index)) \
+	X(void, DisableVertexAttribArray, (GLuint index)) \
+	X(void, MultiDrawElements, (GLenum mode, const GLsizei* count, GLenum type, \
+		const void* const* indices, GLsizei drawcount))
+
+// mapping buffers and fencing what uses them: GL 3.2, or ARB_map_buffer_range and ARB_sync
+#define GL_BUFFER_MAPPING_FUNCTIONS(X) \
+	X(void*, MapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)) \
+	X(GLboolean, UnmapBuffer, (GLenum target)) \
+	X(GLsync, FenceSync, (GLenum condition, GLbitfield flags)) \
+	X(GLenum, ClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout)) \
+	X(void, DeleteSync, (GLsync sync))
+
+// persistent mapping: GL 4.4 or ARB_buffer_storage, on top of the mapping functions
+#define GL_BUFFER_STORAGE_FUNCTIONS(X) \
+	X(void, BufferStorage, (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags))
+
+// instanced drawing: GL 3.3, or ARB_draw_instanced and ARB_instanced_arrays
+#define GL_INSTANCING_FUNCTIONS(X) \
+	X(void, DrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount)) \
+	X(void, VertexAttribDivisor, (GLuint index, GLuint divisor))
+
+// rendering to textures: GL 3.0, or ARB_framebuffer_object and ARB_texture_float
+#define GL_FRAMEBUFFER_FUNCTIONS(X) \
+	X(void, GenFramebuffers, (GLsizei n, GLuint* framebuffers)) \
+	X(void, DeleteFramebuffers, (GLsizei n, const GLuint* framebuffers)) \
+	X(void, BindFramebuffer, (GLenum target, GLuint framebuffer)) \
+	X(void, FramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, \
+		GLint level)) \
+	X(GLenum, CheckFramebufferStatus, (GLenum target))
+
+#define DECLARE_GL_EXTENSION_FUNCTION(ret, name, params) \
+	typedef ret (APIENTRY* PFN_gl##name) params; \
+	extern PFN_gl##name glext_##name;
+GL_EXTENSION_FUNCTIONS(DECLARE_GL_EXTENSION_FUNCTION)
+GL_BUFFER_MAPPING_FUNCTIONS(DECLARE_GL_EXTENSION_FUNCTION)
+GL_BUFFER_STORAGE_FUNCTIONS(DECLARE_GL_EXTENSION_FUNCTION)
+GL_INSTANCING_FUNCTIONS(DECLARE_GL_EXTENSION_FUNCTION)
+GL_FRAMEBUFFER_FUNCTIONS(DECLARE_GL_EXTENSION_FUNCTION)
+#undef DECLARE_GL_EXTENSION_FUNCTION
+
+// the pointers are prefixed so they can't collide with symbols the GL library itself exports
+#define glGenBuffers glext_GenBuffers
+#define glDeleteBuffers glext_DeleteBuffers
+#define glBindBuffer glext_BindBuffer
+#define glBufferData glext_BufferData
+#define glBufferSubData glext_BufferSubData
+#define glCreateShader glext_CreateShader
+#define glDeleteShader glext_DeleteShader
+#define glShaderSource glext_ShaderSource
+#define glCompileShader glext_CompileShader
+#define glGetShaderiv glext_GetShaderiv
+#define glGetShaderInfoLog glext_GetShaderInfoLog
+#define glCreateProgram glext_CreateProgram
+#define glDeleteProgram glext_DeleteProgram
+#define glAttachShader glext_AttachShader
+#define glBindAttribLocation glext_BindAttribLocation
+#define glLinkProgram glext_LinkProgram
+#define glGetProgramiv glext_GetProgramiv
+#define glGetProgramInfoLog glext_GetProgramInfoLog
+#define glUseProgram glext_UseProgram
+#define glGetUniformLocation glext_GetUniformLocation
+#define glUniform1f glext_Uniform1f
+#define glUniform3fv glext_Uniform3fv
+#define glVertexAttribPointer glext_VertexAttribPointer
+#define glEnableVertexAttribArray glext_EnableVertexAttribArray
+#define glDisableVertexAttribArray glext_DisableVertexAttribArray
+#define glMultiDrawElements glext_MultiDrawElements
+#define glBufferStorage glext_BufferStorage
+#define glMapBufferRange glext_MapBufferRange
+#define glUnmapBuffer glext_UnmapBuffer
+#define glFenceSync glext_FenceSync
+#define glClientWaitSync glext_ClientWaitSync
+#define glDeleteSync glext_DeleteSync
+#define glDrawArraysInstanced glext_DrawArraysInstanced
+#define glVertexAttribDivisor glext_VertexAttribDivisor
+#define glGenFramebuffers glext_GenFramebuffers
+#define glDeleteFramebuffers glext_DeleteFramebuffers
+#define glBindFramebuffer glext_BindFramebuffer
+#define glFramebufferTexture2D glext_FramebufferTexture2D
+#define glCheckFramebufferStatus glext_CheckFramebufferStatus
+
+// Looks every function up, false if the context lacks any of them (older than OpenGL 2.0)
+bool loadGLExtensions();
+bool glExtensionsLoaded();
+// true if the GL_BUFFER_MAPPING_FUNCTIONS can be used
+bool glBufferMappingSupported();
+// true if the GL_BUFFER_STORAGE_FUNCTIONS can be used, the mapping ones then can too
+bool glBufferStorageSupported();
+// true if the GL_INSTANCING_FUNCTIONS can be used
+bool glInstancingSupported();
+// true if the GL_FRAMEBUFFER_FUNCTIONS can be used and GL_RGBA16F textures rendered to
+bool glFramebufferSupported();
+// true if glReadPixels can read into a GL_PIXEL_PACK_BUFFER: GL 2.1 or ARB_pixel_buffer_object
+bool glPixelPackBufferSupported();
+
+// Compiles and links a program, either shader may be null to keep the fixed-function stage.
+// Attribute i of attributes is bound to location i. Returns 0 and logs the error on failure.
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource,
+	const char* const* attributes, int numAttributes);
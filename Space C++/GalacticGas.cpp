@@ -1,9 +1,18 @@
 #include "GalacticGas.h"
 #include "SolarSystem.h"
-#include <GLFW/glfw3.h>
+#include "ExponentialDisk.h"
+#include "SpiralArmField.h"
+#include "Random.h"
+#include "OrbitKernels.h"
+#include "ThreadPool.h"
+#include "StreamBuffer.h"
+#include "GasIndex.h"
+#include "Camera.h"
 #include <iostream>
 #include <cmath>
 #include <random>
+#include <algorithm>
+#include <atomic>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -105,380 +114,687 @@ Color4 getGasColor(GasType type, float temperature, float density, bool& isDarkL
     return color;
 }
 
-void generateSpiralArmCloud(GasCloud& cloud, std::mt19937& rng, int numArms,
-                           double spiralTightness, double armWidth, double diskRadius) {
+void generateSpiralArmCloud(GasCloud& cloud, std::mt19937& rng, const SpiralArmField& armField,
+                           double armWidth, double diskRadius) {
     std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 
     // choose an arm
-    int armIndex = rng() % numArms;
-    float armAngle = (armIndex * 2.0f * M_PI) / numArms;
+    int armIndex = rng() % armField.numArms;
 
     // position along the arm
     float radius = 100.0f + dist(rng) * (diskRadius * 0.8f);
-    float spiralAngle = armAngle + spiralTightness * log(radius / 100.0f);
+    float spiralAngle = armField.armCenterAngle(radius, armIndex);
 
-    // add scatter around arm center
+    // add scatter around arm center, measured along the circle like the stars' arm distance
     float armOffset = (dist(rng) - 0.5f) * armWidth;
-    float perpAngle = spiralAngle + M_PI / 2.0f;
+    float angle = spiralAngle + armOffset / radius;
 
-    cloud.x = radius * cos(spiralAngle) + armOffset * cos(perpAngle);
-    cloud.z = radius * sin(spiralAngle) + armOffset * sin(perpAngle);
+    cloud.x = radius * cos(angle);
+    cloud.z = radius * sin(angle);
 
-    cloud.orbitalRadius = sqrt(cloud.x * cloud.x + cloud.z * cloud.z);
+    cloud.orbitalRadius = radius;
     cloud.angle = atan2(cloud.z, cloud.x);
 }
 
-void generateGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& config,
-                         unsigned int seed, double diskRadius, double bulgeRadius) {
-    std::mt19937 rng(seed + 12345); // offset seed from stars
+const int GAS_TYPE_COUNT = 6;
+
+// bumped whenever clouds are generated or loaded, so splats built from the old ones are rebuilt
+static std::atomic<unsigned long long> gasCloudsGeneration{ 0 };
+
+void markGasCloudsChanged() {
+    ++gasCloudsGeneration;
+}
+
+// clouds of a population come in chunks of this size, each from its own random stream
+const int GAS_CHUNK_SIZE = 1024;
+
+static int gasPopulationCount(const GasConfig& config, GasType type) {
+    switch (type) {
+        case GasType::MOLECULAR: return config.numMolecularClouds;
+        case GasType::COLD_NEUTRAL: return config.numColdNeutralClouds;
+        case GasType::WARM_NEUTRAL: return config.numWarmNeutralClouds;
+        case GasType::WARM_IONIZED: return config.numWarmIonizedClouds;
+        case GasType::HOT_IONIZED: return config.numHotIonizedClouds;
+        case GasType::CORONAL: return config.numCoronalClouds;
+    }
+    return 0;
+}
+
+// everything the cloud generator needs apart from the rng
+struct GasGenerationContext {
+    const GasConfig* config;
+    const SpiralArmField* armField;
+    double diskRadius;
+    double bulgeRadius;
+    double armWidth;
+
+    ExponentialDiskSampler coldNeutralDisk;
+    ExponentialDiskSampler warmNeutralDisk;
+    ExponentialDiskSampler hotIonizedDisk;
+};
+
+// Spawning gas clouds by type
+// The data on these is approximate and based on what I foudn online
+// so treat it, as everything else in this simulation, as a rough approximation :thumbs_up:
+static void generateGasCloud(GasCloud& cloud, GasType type, std::mt19937& rng, const GasGenerationContext& ctx) {
     std::uniform_real_distribution<float> dist(0.0f, 1.0f);
     std::normal_distribution<float> normalDist(0.0f, 1.0f);
 
-    gasClouds.clear();
+    const GasConfig& config = *ctx.config;
+    const double diskRadius = ctx.diskRadius;
+    const double bulgeRadius = ctx.bulgeRadius;
 
-    int totalClouds = config.numMolecularClouds + config.numColdNeutralClouds +
-                      config.numWarmNeutralClouds + config.numWarmIonizedClouds +
-                      config.numHotIonizedClouds + config.numCoronalClouds;
-    gasClouds.reserve(totalClouds);
+    cloud.type = type;
 
-    const int numArms = 2;
-    const double spiralTightness = 0.3;
-    const double armWidth = 60.0;
+    switch (type) {
+        case GasType::MOLECULAR: {
+            cloud.temperature = MOLECULAR_TEMP;
 
-    // Spawning gas clouds by type
-    // The data on these is approximate and based on what I foudn online
-    // so treat it, as everything else in this simulation, as a rough approximation :thumbs_up:
-    // MOLECULAR CLOUDS
-    for (int i = 0; i < config.numMolecularClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::MOLECULAR;
-        cloud.temperature = MOLECULAR_TEMP;
+            generateSpiralArmCloud(cloud, rng, *ctx.armField, ctx.armWidth, diskRadius);
 
-        generateSpiralArmCloud(cloud, rng, numArms, spiralTightness, armWidth, diskRadius);
+            cloud.y = normalDist(rng) * config.molecularScaleHeight;
 
-        cloud.y = normalDist(rng) * config.molecularScaleHeight;
+            cloud.mass = 1000.0f + dist(rng) * 100000.0f;
+            cloud.smoothingLength = 10.0f + dist(rng) * 25.0f;
+            cloud.density = 0.7f + dist(rng) * 0.3f;
 
-        cloud.mass = 1000.0f + dist(rng) * 100000.0f;
-        cloud.smoothingLength = 10.0f + dist(rng) * 25.0f;
-        cloud.density = 0.7f + dist(rng) * 0.3f;
+            // orbital motion (slower in spiral arms due to density wave)
+            cloud.angularVelocity = 0.3f / (sqrt(cloud.orbitalRadius / bulgeRadius) * (cloud.orbitalRadius + 1.0f));
 
-        // orbital motion (slower in spiral arms due to density wave)
-        cloud.angularVelocity = 0.3f / (sqrt(cloud.orbitalRadius / bulgeRadius) * (cloud.orbitalRadius + 1.0f));
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.1f + dist(rng) * 0.2f;
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.1f + dist(rng) * 0.2f;
+            cloud.elongation = 5.0f + dist(rng) * 5.0f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
+        }
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+        case GasType::COLD_NEUTRAL: {
+            cloud.temperature = COLD_NEUTRAL_TEMP;
 
-        cloud.elongation = 5.0f + dist(rng) * 5.0f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            // Exponential disk distribution
+            float radius = ctx.coldNeutralDisk.sample(dist(rng) * 0.95f);
 
-        gasClouds.push_back(cloud);
-    }
+            if (radius > diskRadius * 1.2f) {
+                radius = diskRadius * 1.2f;
+            }
 
-    // COLD NEUTRAL
-    for (int i = 0; i < config.numColdNeutralClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::COLD_NEUTRAL;
-        cloud.temperature = COLD_NEUTRAL_TEMP;
+            float theta = dist(rng) * 2.0f * M_PI;
+            cloud.x = radius * cos(theta);
+            cloud.z = radius * sin(theta);
+            cloud.y = normalDist(rng) * config.neutralScaleHeight;
 
-        // Exponential disk distribution
-        float diskScale = diskRadius * 0.3f;
-        float u = dist(rng);
-        float radius = -diskScale * log(1.0f - u * 0.95f + 1e-8f);
+            cloud.orbitalRadius = radius;
+            cloud.angle = theta;
+            cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
 
-        if (radius > diskRadius * 1.2f) {
-            radius = diskRadius * 1.2f;
-        }
+            cloud.mass = 100.0f + dist(rng) * 1000.0f;
+            cloud.smoothingLength = 8.0f + dist(rng) * 20.0f;
+            cloud.density = 0.3f + dist(rng) * 0.4f;
 
-        float theta = dist(rng) * 2.0f * M_PI;
-        cloud.x = radius * cos(theta);
-        cloud.z = radius * sin(theta);
-        cloud.y = normalDist(rng) * config.neutralScaleHeight;
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.2f + dist(rng) * 0.3f;
 
-        cloud.orbitalRadius = radius;
-        cloud.angle = theta;
-        cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
+            cloud.elongation = 2.0f + dist(rng) * 2.0f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
+        }
 
-        cloud.mass = 100.0f + dist(rng) * 1000.0f;
-        cloud.smoothingLength = 8.0f + dist(rng) * 20.0f;
-        cloud.density = 0.3f + dist(rng) * 0.4f;
+        case GasType::WARM_NEUTRAL: {
+            cloud.temperature = WARM_NEUTRAL_TEMP;
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.2f + dist(rng) * 0.3f;
+            // widespread in disk
+            float radius = ctx.warmNeutralDisk.sample(dist(rng) * 0.95f);
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+            if (radius > diskRadius * 1.5f) {
+                radius = diskRadius * 1.5f;
+            }
 
-        cloud.elongation = 2.0f + dist(rng) * 2.0f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            float theta = dist(rng) * 2.0f * M_PI;
+            cloud.x = radius * cos(theta);
+            cloud.z = radius * sin(theta);
+            cloud.y = normalDist(rng) * config.neutralScaleHeight * 1.5f;
 
-        gasClouds.push_back(cloud);
-    }
+            cloud.orbitalRadius = radius;
+            cloud.angle = theta;
+            cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
 
-    // WARM NEUTRAL
-    for (int i = 0; i < config.numWarmNeutralClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::WARM_NEUTRAL;
-        cloud.temperature = WARM_NEUTRAL_TEMP;
+            cloud.mass = 50.0f + dist(rng) * 500.0f;
+            cloud.smoothingLength = 10.0f + dist(rng) * 30.0f;
+            cloud.density = 0.2f + dist(rng) * 0.3f;
 
-        // widespread in disk
-        float diskScale = diskRadius * 0.35f;
-        float u = dist(rng);
-        float radius = -diskScale * log(1.0f - u * 0.95f + 1e-8f);
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.3f + dist(rng) * 0.4f;
 
-        if (radius > diskRadius * 1.5f) {
-            radius = diskRadius * 1.5f;
+            cloud.elongation = 2.0f + dist(rng) * 1.0f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
         }
 
-        float theta = dist(rng) * 2.0f * M_PI;
-        cloud.x = radius * cos(theta);
-        cloud.z = radius * sin(theta);
-        cloud.y = normalDist(rng) * config.neutralScaleHeight * 1.5f;
+        case GasType::WARM_IONIZED: {
+            cloud.temperature = WARM_IONIZED_TEMP;
 
-        cloud.orbitalRadius = radius;
-        cloud.angle = theta;
-        cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
+            // concentrated tightly in spiral arms
+            generateSpiralArmCloud(cloud, rng, *ctx.armField, ctx.armWidth * 0.8f, diskRadius);
 
-        cloud.mass = 50.0f + dist(rng) * 500.0f;
-        cloud.smoothingLength = 10.0f + dist(rng) * 30.0f;
-        cloud.density = 0.2f + dist(rng) * 0.3f;
+            cloud.y = normalDist(rng) * config.molecularScaleHeight * 2.0f;
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.3f + dist(rng) * 0.4f;
+            cloud.mass = 10.0f + dist(rng) * 100.0f;
+            cloud.smoothingLength = 6.0f + dist(rng) * 20.0f;
+            cloud.density = 0.6f + dist(rng) * 0.4f;
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+            cloud.angularVelocity = 0.35f / (sqrt(cloud.orbitalRadius / bulgeRadius) * (cloud.orbitalRadius + 1.0f));
 
-        cloud.elongation = 2.0f + dist(rng) * 1.0f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.4f + dist(rng) * 0.5f;
 
-        gasClouds.push_back(cloud);
-    }
+            cloud.elongation = 1.2f + dist(rng) * 0.8f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
+        }
+
+        case GasType::HOT_IONIZED: {
+            cloud.temperature = HOT_IONIZED_TEMP;
 
-    // WARM IONIZED
-    for (int i = 0; i < config.numWarmIonizedClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::WARM_IONIZED;
-        cloud.temperature = WARM_IONIZED_TEMP;
+            // scattered throughout disk, some concentration in arms
+            float radius = ctx.hotIonizedDisk.sample(dist(rng) * 0.9f);
 
-        // concentrated tightly in spiral arms
-        generateSpiralArmCloud(cloud, rng, numArms, spiralTightness, armWidth * 0.8f, diskRadius);
+            if (radius > diskRadius * 1.3f) {
+                radius = diskRadius * 1.3f;
+            }
 
-        cloud.y = normalDist(rng) * config.molecularScaleHeight * 2.0f;
+            float theta = dist(rng) * 2.0f * M_PI;
+            cloud.x = radius * cos(theta);
+            cloud.z = radius * sin(theta);
+            cloud.y = normalDist(rng) * config.ionizedScaleHeight;
 
-        cloud.mass = 10.0f + dist(rng) * 100.0f;
-        cloud.smoothingLength = 6.0f + dist(rng) * 20.0f;
-        cloud.density = 0.6f + dist(rng) * 0.4f;
+            cloud.orbitalRadius = radius;
+            cloud.angle = theta;
+            cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
 
-        cloud.angularVelocity = 0.35f / (sqrt(cloud.orbitalRadius / bulgeRadius) * (cloud.orbitalRadius + 1.0f));
+            cloud.mass = 1.0f + dist(rng) * 50.0f;
+            cloud.smoothingLength = 12.0f + dist(rng) * 40.0f;
+            cloud.density = 0.15f + dist(rng) * 0.25f;
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.4f + dist(rng) * 0.5f;
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.6f + dist(rng) * 0.8f;
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+            cloud.elongation = 1.0f + dist(rng) * 1.0f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
+        }
 
-        cloud.elongation = 1.2f + dist(rng) * 0.8f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+        case GasType::CORONAL: {
+            cloud.temperature = CORONAL_TEMP;
 
-        gasClouds.push_back(cloud);
-    }
+            // spherical halo distribution
+            float theta = dist(rng) * 2.0f * M_PI;
+            float phi = acos(2.0f * dist(rng) - 1.0f);
+            float radius = pow(dist(rng), 0.5f) * diskRadius * 2.5f;
 
-    // HOT IONIZED
-    for (int i = 0; i < config.numHotIonizedClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::HOT_IONIZED;
-        cloud.temperature = HOT_IONIZED_TEMP;
+            cloud.x = radius * sin(phi) * cos(theta);
+            cloud.y = radius * sin(phi) * sin(theta);
+            cloud.z = radius * cos(phi);
 
-        // scattered throughout disk, some concentration in arms
-        float diskScale = diskRadius * 0.4f;
-        float u = dist(rng);
-        float radius = -diskScale * log(1.0f - u * 0.9f + 1e-8f);
+            cloud.orbitalRadius = sqrt(cloud.x * cloud.x + cloud.z * cloud.z);
+            cloud.angle = atan2(cloud.z, cloud.x);
+            cloud.angularVelocity = 0.1f / (cloud.orbitalRadius + 1.0f);
 
-        if (radius > diskRadius * 1.3f) {
-            radius = diskRadius * 1.3f;
+            // Very diffuse
+            cloud.mass = 0.1f + dist(rng) * 10.0f;
+            cloud.smoothingLength = 40.0f + dist(rng) * 120.0f;
+            cloud.density = 0.05f + dist(rng) * 0.1f;
+
+            cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
+            cloud.turbulenceSpeed = 0.05f + dist(rng) * 0.1f;
+
+            cloud.elongation = 1.0f + dist(rng) * 0.5f;
+            cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+            break;
         }
+    }
 
-        float theta = dist(rng) * 2.0f * M_PI;
-        cloud.x = radius * cos(theta);
-        cloud.z = radius * sin(theta);
-        cloud.y = normalDist(rng) * config.ionizedScaleHeight;
+    bool isDark;
+    Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
+    cloud.r = col.r;
+    cloud.g = col.g;
+    cloud.b = col.b;
+    cloud.alpha = col.a;
+    cloud.isDarkLane = isDark;
+}
 
-        cloud.orbitalRadius = radius;
-        cloud.angle = theta;
-        cloud.angularVelocity = 0.4f / (sqrt(radius / bulgeRadius) * (radius + 1.0f));
+// Generates clouds [first, first + count) of one population.
+// Cloud i always comes out of chunk i / GAS_CHUNK_SIZE of the population's own stream,
+// so a population's first n clouds are the same whatever its count or the other populations' counts
+static void generateGasPopulation(GasCloud* out, GasType type, int first, int count,
+                                  unsigned int seed, const GasGenerationContext& ctx) {
+    const int end = first + count;
+    const uint32_t stream = RNG_STREAM_GAS_MOLECULAR + static_cast<uint32_t>(type);
+
+    for (int chunkBegin = first - first % GAS_CHUNK_SIZE; chunkBegin < end; chunkBegin += GAS_CHUNK_SIZE) {
+        std::mt19937 rng(deriveStreamSeed(seed, stream, chunkBegin / GAS_CHUNK_SIZE));
+        int chunkEnd = std::min(chunkBegin + GAS_CHUNK_SIZE, end);
+
+        // clouds before first are only generated to move the stream along
+        GasCloud skipped;
+        for (int i = chunkBegin; i < chunkEnd; i++) {
+            generateGasCloud(i < first ? skipped : out[i - first], type, rng, ctx);
+        }
+    }
+}
 
-        cloud.mass = 1.0f + dist(rng) * 50.0f;
-        cloud.smoothingLength = 12.0f + dist(rng) * 40.0f;
-        cloud.density = 0.15f + dist(rng) * 0.25f;
+// previousConfig == nullptr generates everything, otherwise gasClouds holds the clouds
+// previousConfig generated and each population keeps as many of them as it still has
+static void buildGasPopulations(std::vector<GasCloud>& gasClouds, const GasConfig* previousConfig,
+                                const GasConfig& config, unsigned int seed, double diskRadius,
+                                double bulgeRadius, const SpiralArmField& armField) {
+    GasGenerationContext ctx;
+    ctx.config = &config;
+    ctx.armField = &armField;
+    ctx.diskRadius = diskRadius;
+    ctx.bulgeRadius = bulgeRadius;
+
+    // clouds follow the same arms as the stars
+    ctx.armWidth = armField.armWidth;
+
+    // exponential disks of the diffuse populations (the top of the CDF is cut off)
+    // a disk's mean radius is 2x its scale, so these keep the clouds as spread out as before
+    ctx.coldNeutralDisk = makeExponentialDiskSampler(diskRadius * 0.15f);
+    ctx.warmNeutralDisk = makeExponentialDiskSampler(diskRadius * 0.175f);
+    ctx.hotIonizedDisk = makeExponentialDiskSampler(diskRadius * 0.2f);
+
+    int totalClouds = 0;
+    for (int t = 0; t < GAS_TYPE_COUNT; t++) {
+        totalClouds += gasPopulationCount(config, static_cast<GasType>(t));
+    }
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.6f + dist(rng) * 0.8f;
+    std::vector<GasCloud> clouds(totalClouds);
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+    // populations are stored one after another in GasType order
+    int previousOffset = 0;
+    int offset = 0;
+    for (int t = 0; t < GAS_TYPE_COUNT; t++) {
+        GasType type = static_cast<GasType>(t);
+        int count = gasPopulationCount(config, type);
+        int previousCount = previousConfig ? gasPopulationCount(*previousConfig, type) : 0;
+        int kept = std::min(previousCount, count);
 
-        cloud.elongation = 1.0f + dist(rng) * 1.0f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+        std::copy(gasClouds.begin() + previousOffset, gasClouds.begin() + previousOffset + kept,
+                  clouds.begin() + offset);
+        generateGasPopulation(clouds.data() + offset + kept, type, kept, count - kept, seed, ctx);
 
-        gasClouds.push_back(cloud);
+        previousOffset += previousCount;
+        offset += count;
     }
 
-    // CORONAL GAS
-    for (int i = 0; i < config.numCoronalClouds; i++) {
-        GasCloud cloud;
-        cloud.type = GasType::CORONAL;
-        cloud.temperature = CORONAL_TEMP;
+    gasClouds.swap(clouds);
+    markGasCloudsChanged();
+}
 
-        // spherical halo distribution
-        float theta = dist(rng) * 2.0f * M_PI;
-        float phi = acos(2.0f * dist(rng) - 1.0f);
-        float radius = pow(dist(rng), 0.5f) * diskRadius * 2.5f;
+void generateGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& config,
+                         unsigned int seed, double diskRadius, double bulgeRadius,
+                         const SpiralArmField& armField) {
+    buildGasPopulations(gasClouds, nullptr, config, seed, diskRadius, bulgeRadius, armField);
+}
 
-        cloud.x = radius * sin(phi) * cos(theta);
-        cloud.y = radius * sin(phi) * sin(theta);
-        cloud.z = radius * cos(phi);
+void extendGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& previousConfig,
+                       const GasConfig& config, unsigned int seed, double diskRadius,
+                       double bulgeRadius, const SpiralArmField& armField) {
+    buildGasPopulations(gasClouds, &previousConfig, config, seed, diskRadius, bulgeRadius, armField);
+}
 
-        cloud.orbitalRadius = sqrt(cloud.x * cloud.x + cloud.z * cloud.z);
-        cloud.angle = atan2(cloud.z, cloud.x);
-        cloud.angularVelocity = 0.1f / (cloud.orbitalRadius + 1.0f);
+bool galacticGasCompatible(const GasConfig& a, const GasConfig& b) {
+    return a.molecularScaleHeight == b.molecularScaleHeight &&
+           a.neutralScaleHeight == b.neutralScaleHeight &&
+           a.ionizedScaleHeight == b.ionizedScaleHeight &&
+           a.coronalScaleHeight == b.coronalScaleHeight &&
+           a.enableTurbulence == b.enableTurbulence &&
+           a.enableDensityWaves == b.enableDensityWaves;
+}
 
-        // Very diffuse
-        cloud.mass = 0.1f + dist(rng) * 10.0f;
-        cloud.smoothingLength = 40.0f + dist(rng) * 120.0f;
-        cloud.density = 0.05f + dist(rng) * 0.1f;
+void computeGasCloudPositions(const std::vector<GasCloud>& gasClouds, double time, std::vector<float>& positions) {
+    positions.resize(gasClouds.size() * 2);
+
+    parallelFor(g_threadPool, gasClouds.size(), 1024, [&](size_t begin, size_t end) {
+        // the clouds are AoS, so their orbits are gathered into blocks for the SIMD kernel
+        const size_t BLOCK = 256;
+        float radius[BLOCK], angle[BLOCK], angularVelocity[BLOCK];
+        float x[BLOCK], z[BLOCK];
+
+        for (size_t blockBegin = begin; blockBegin < end; blockBegin += BLOCK) {
+            size_t count = std::min(BLOCK, end - blockBegin);
+            for (size_t i = 0; i < count; i++) {
+                const GasCloud& cloud = gasClouds[blockBegin + i];
+                radius[i] = cloud.orbitalRadius;
+                angle[i] = cloud.angle;
+                angularVelocity[i] = cloud.angularVelocity;
+            }
 
-        cloud.turbulencePhase = dist(rng) * 2.0f * M_PI;
-        cloud.turbulenceSpeed = 0.05f + dist(rng) * 0.1f;
+            computeOrbitXZ(radius, angle, angularVelocity, count, time, x, z);
 
-        bool isDark;
-        Color4 col = getGasColor(cloud.type, cloud.temperature, cloud.density, isDark);
-        cloud.r = col.r;
-        cloud.g = col.g;
-        cloud.b = col.b;
-        cloud.alpha = col.a;
-        cloud.isDarkLane = isDark;
+            for (size_t i = 0; i < count; i++) {
+                positions[(blockBegin + i) * 2 + 0] = x[i];
+                positions[(blockBegin + i) * 2 + 1] = z[i];
+            }
+        }
+    });
+}
 
-        cloud.elongation = 1.0f + dist(rng) * 0.5f;
-        cloud.rotationAngle = dist(rng) * 2.0f * M_PI;
+// The billboard path: every cloud is one instance of a quad, sized in world units so it
+// shrinks and grows with distance like the rest of the scene, and stretched along its axis.
+// Its look comes from its GasType's sprite, which has the layers the point path draws baked in.
+// The sprites of the clouds in view are streamed each frame, so a pass is one instanced draw
+static const char* GAS_VERTEX_SHADER = R"(
+#version 120
+attribute vec2 corner;
+attribute vec3 center;
+attribute vec4 shape;
+attribute vec4 color;
+attribute float sprite;
+
+varying vec2 spriteCoord;
+varying vec4 splatColor;
+
+void main() {
+    vec4 viewCenter = gl_ModelViewMatrix * vec4(center, 1.0);
+
+    // the long axis lies in the galactic plane, seen end on it shrinks to the short one
+    vec3 axis = mat3(gl_ModelViewMatrix) * vec3(shape.z, 0.0, shape.w);
+    float scale = length(axis);
+    float across = length(axis.xy);
+    vec2 along = across > scale * 0.001 ? axis.xy / across : vec2(1.0, 0.0);
+    float major = mix(shape.y, shape.x, across / scale);
+
+    vec2 offset = (along * (corner.x * major) + vec2(-along.y, along.x) * (corner.y * shape.y)) * scale;
+    gl_Position = gl_ProjectionMatrix * (viewCenter + vec4(offset, 0.0, 0.0));
+
+    // the corners land on the centres of the tile's edge texels, GAS_SPRITE_SIZE of them a side
+    vec2 inTile = 0.5 + corner * (0.5 * 63.0 / 64.0);
+    spriteCoord = vec2((sprite + inTile.x) / 8.0, inTile.y);
+    splatColor = color;
+}
+)";
 
-        gasClouds.push_back(cloud);
-    }
+static const char* GAS_FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D sprites;
+uniform float darkening;
+
+varying vec2 spriteCoord;
+varying vec4 splatColor;
+
+void main() {
+    float profile = texture2D(sprites, spriteCoord).r;
+    if (darkening > 0.5) gl_FragColor = vec4(vec3(1.0 - splatColor.a * profile), 1.0);
+    else gl_FragColor = vec4(splatColor.rgb, splatColor.a * profile);
 }
+)";
 
-void updateGalacticGas(std::vector<GasCloud>& gasClouds, double deltaTime) {
-    const float TWO_PI = 2.0f * M_PI;
+// bound in this order, so the per-vertex corner is attribute 0 and stands in for gl_Vertex
+static const char* const GAS_ATTRIBUTES[] = { "corner", "center", "shape", "color", "sprite" };
+const int GAS_ATTRIBUTE_COUNT = 5;
 
-    for (auto& cloud : gasClouds) {
-        cloud.angle += cloud.angularVelocity * deltaTime;
+// The sprites are tiles of one atlas, side by side in GasType order.
+// The shader's texture coordinates assume these sizes
+const int GAS_SPRITE_SIZE = 64;
+const int GAS_SPRITE_TILES = 8;
 
-        cloud.angle = fmodf(cloud.angle, TWO_PI);
-        if (cloud.angle < 0.0f) cloud.angle += TWO_PI;
+// the middle of each population's elongation range in generateGasCloud; a sprite's filaments
+// are spaced for it, each cloud's quad is still stretched by its own
+static const float GAS_SPRITE_ELONGATION[GAS_TYPE_COUNT] = { 7.5f, 3.0f, 2.5f, 1.6f, 1.5f, 1.25f };
 
-        float oldY = cloud.y;
-        cloud.x = cloud.orbitalRadius * cos(cloud.angle);
-        cloud.z = cloud.orbitalRadius * sin(cloud.angle);
+// the layers of the point path at full detail
+const int GAS_SPRITE_DARK_LANE_LAYERS = 4;
+const int GAS_SPRITE_FILAMENTS = 3;
+const int GAS_SPRITE_LAYERS_PER_FILAMENT = 4;
 
-        if (cloud.type != GasType::CORONAL) {
-            cloud.y = oldY;
-        }
+// 1 inside an ellipse of normalised distance d, falling to 0 at its rim over a couple of texels
+static float spriteDiscCoverage(float d) {
+    return std::min(1.0f, std::max(0.0f, (1.0f - d) * (GAS_SPRITE_SIZE / 4.0f)));
+}
 
-        cloud.turbulencePhase += cloud.turbulenceSpeed * deltaTime;
-        cloud.turbulencePhase = fmodf(cloud.turbulencePhase, TWO_PI);
-        if (cloud.turbulencePhase < 0.0f) cloud.turbulencePhase += TWO_PI;
+// How far a sprite reaches from its cloud, in units of smoothingLength.
+// Dark lanes are their outermost layer; emissive clouds their widest layer plus the outer
+// filaments' offsets along the axis, and across only that layer narrowed by the elongation
+static void gasSpriteRadii(bool darkLane, float elongation, float& along, float& across) {
+    const float stretch = 1.0f + elongation * 0.5f;
+    if (darkLane) {
+        along = 1.3f;
+        across = along / stretch;
+    } else {
+        const float widestLayer = 0.72f * stretch;
+        along = widestLayer + 0.4f * (GAS_SPRITE_FILAMENTS / 2);
+        across = 0.72f;
     }
 }
 
-void renderGalacticGas(const std::vector<GasCloud>& gasClouds, const RenderZone& zone) {
-    glEnable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_POINT_SMOOTH);
+float gasCloudReach(const GasCloud& cloud) {
+    float along, across;
+    gasSpriteRadii(cloud.isDarkLane, cloud.elongation, along, across);
+    return along * cloud.smoothingLength;
+}
 
-    // LOD based on zoom
-    int numFilaments = 3;
-    int numLayersPerFilament = 4;
-    if (zone.zoomLevel < 0.5) {
-        numFilaments = 2;
-        numLayersPerFilament = 3;
+// Sums the point path's layers of one GasType over the tile at tileX, in the units of a cloud
+// with smoothingLength 1: each layer an ellipse, narrowed across the axis by the elongation.
+// Dark lanes add up the extinction their layers multiply in, which is tiny, so the sum is the
+// product to well under a texel's precision. Returns the largest sum, the tile is scaled to 1 by it
+static float bakeGasSprite(GasType type, int tileX, std::vector<unsigned char>& atlas) {
+    const bool darkLane = type == GasType::MOLECULAR;
+    const float elongation = GAS_SPRITE_ELONGATION[static_cast<int>(type)];
+    const float stretch = 1.0f + elongation * 0.5f;
+    float along, across;
+    gasSpriteRadii(darkLane, elongation, along, across);
+
+    // layer centre along the axis, radius along it, and weight
+    struct Layer { float center, radius, weight; };
+    std::vector<Layer> layers;
+    if (darkLane) {
+        const float centerWeight = cubicSplineKernel2D(0.0f, 1.0f);
+        for (int i = 0; i < GAS_SPRITE_DARK_LANE_LAYERS; i++) {
+            float t = i / (float)(GAS_SPRITE_DARK_LANE_LAYERS - 1);
+            layers.push_back({ 0.0f, 1.0f + t * 0.3f, cubicSplineKernel2D(t * 2.0f, 1.0f) / centerWeight });
+        }
+    } else {
+        for (int f = 0; f < GAS_SPRITE_FILAMENTS; f++) {
+            const float filamentFalloff = exp(-f * f * 0.8f);
+            for (int i = 0; i < GAS_SPRITE_LAYERS_PER_FILAMENT; i++) {
+                float t = i / (float)(GAS_SPRITE_LAYERS_PER_FILAMENT - 1);
+                float gaussian = exp(-t * t * 2.5f);
+                layers.push_back({ (f - GAS_SPRITE_FILAMENTS / 2) * 0.4f, 0.6f * stretch * (1.0f + t * 0.2f),
+                                   gaussian * filamentFalloff });
+            }
+        }
     }
 
-    // culling at high zoom
-    int skipFactor = 1;
-    if (zone.zoomLevel > 100.0) skipFactor = 4;
-    else if (zone.zoomLevel > 50.0) skipFactor = 3;
-    else if (zone.zoomLevel > 20.0) skipFactor = 2;
+    std::vector<float> sums(GAS_SPRITE_SIZE * GAS_SPRITE_SIZE);
+    float peak = 0.0f;
+    for (int y = 0; y < GAS_SPRITE_SIZE; y++) {
+        for (int x = 0; x < GAS_SPRITE_SIZE; x++) {
+            // texel centres, the edge ones on the quad's rim
+            float u = (x / (float)(GAS_SPRITE_SIZE - 1) * 2.0f - 1.0f) * along;
+            float v = (y / (float)(GAS_SPRITE_SIZE - 1) * 2.0f - 1.0f) * across;
+
+            float sum = 0.0f;
+            for (const Layer& layer : layers) {
+                float du = (u - layer.center) / layer.radius;
+                float dv = v * stretch / layer.radius;
+                sum += layer.weight * spriteDiscCoverage(sqrt(du * du + dv * dv));
+            }
+            sums[y * GAS_SPRITE_SIZE + x] = sum;
+            peak = std::max(peak, sum);
+        }
+    }
 
-    const int MAX_SIZE_BINS = 40;
-    const float SIZE_BIN = 5.0f;
+    const int atlasWidth = GAS_SPRITE_SIZE * GAS_SPRITE_TILES;
+    for (int y = 0; y < GAS_SPRITE_SIZE; y++) {
+        for (int x = 0; x < GAS_SPRITE_SIZE; x++) {
+            float value = peak > 0.0f ? sums[y * GAS_SPRITE_SIZE + x] / peak : 0.0f;
+            atlas[y * atlasWidth + tileX + x] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+        }
+    }
+    return peak;
+}
 
-    static std::vector<float> verticesBySize[MAX_SIZE_BINS];
-    static std::vector<float> colorsBySize[MAX_SIZE_BINS];
+// sprites smaller than this many pixels across aren't drawn
+const float GAS_MIN_SPRITE_PIXELS = 1.0f;
 
-    static std::vector<int> darkLaneIndices;
-    static std::vector<int> emissiveIndices;
+// what each GasType's sprite was divided by when it was baked
+static float gasSpritePeaks[GAS_TYPE_COUNT];
 
-    darkLaneIndices.clear();
-    emissiveIndices.clear();
-    darkLaneIndices.reserve(gasClouds.size() / 10);
-    emissiveIndices.reserve(gasClouds.size());
+// Without instancing the splats are round points, their sizes quantised into bins of
+// SIZE_BIN pixels, each drawn with its own glPointSize
+const int MAX_SIZE_BINS = 40;
+const float SIZE_BIN = 5.0f;
 
-    for (size_t i = 0; i < gasClouds.size(); i++) {
-        if (gasClouds[i].isDarkLane) {
-            darkLaneIndices.push_back(i);
-        } else {
-            emissiveIndices.push_back(i);
-        }
+static int sizeBinOf(float size) {
+    int sizeBin = (int)(size / SIZE_BIN);
+    if (sizeBin < 0) sizeBin = 0;
+    if (sizeBin >= MAX_SIZE_BINS) sizeBin = MAX_SIZE_BINS - 1;
+    return sizeBin;
+}
+
+struct PendingSplat {
+    uint32_t cloud;
+    float offset[3];
+    float shape[4];
+    float color[4];
+    float sprite;
+};
+
+// The splats of one blend pass, sorted by size bin. Everything about a splat except where its
+// cloud has orbited to is fixed, so it is built once and each frame only adds the orbit positions.
+// The point path's splats are the layers of the clouds, the billboards' are one sprite per cloud
+struct GasSplatPass {
+    std::vector<uint32_t> clouds;      // the cloud of each splat
+    std::vector<float> offsets;        // x, y, z from the cloud's orbit position (y is its height)
+    std::vector<float> colors;         // rgba; a sprite's alpha is scaled by its peak
+    int binStart[MAX_SIZE_BINS + 1];
+
+    // points only, the splats of the clouds in view this frame, in binStart order
+    std::vector<float> visibleVertices;   // offsets moved to this frame's positions
+    std::vector<float> visibleColors;
+    int visibleBinStart[MAX_SIZE_BINS + 1];
+
+    // sprites only
+    std::vector<float> shapes;         // radius along the cloud's axis and across it, the axis's cos and sin
+    std::vector<float> sprites;        // the atlas tile, the cloud's GasType
+
+    // splats are added in draw order within a bin and gathered into binStart order by finishPass
+    std::vector<PendingSplat> pending[MAX_SIZE_BINS];
+
+    void add(float size, uint32_t cloud, float x, float y, float z, float r, float g, float b, float a) {
+        pending[sizeBinOf(size)].push_back({ cloud, { x, y, z }, {}, { r, g, b, a }, 0.0f });
     }
 
-    for (int i = 0; i < MAX_SIZE_BINS; i++) {
-        verticesBySize[i].clear();
-        colorsBySize[i].clear();
+    // sprites aren't drawn as points, they all go in the first bin
+    void addSprite(const GasCloud& cloud, uint32_t cloudIndex, float r, float g, float b, float a) {
+        float along, across;
+        gasSpriteRadii(cloud.isDarkLane, cloud.elongation, along, across);
+        const float cosRotation = cos(cloud.rotationAngle);
+        const float sinRotation = sin(cloud.rotationAngle);
+        const int type = static_cast<int>(cloud.type);
+        pending[0].push_back({ cloudIndex, { 0.0f, cloud.y, 0.0f },
+                               { along * cloud.smoothingLength, across * cloud.smoothingLength,
+                                 cosRotation, sinRotation },
+                               { r, g, b, a * gasSpritePeaks[type] }, static_cast<float>(type) });
     }
+};
 
-    int estimatedVerticesPerBin = (gasClouds.size() / MAX_SIZE_BINS) * 4 * 3;
-    int estimatedColorsPerBin = (gasClouds.size() / MAX_SIZE_BINS) * 4 * 4;
-    for (int i = 0; i < MAX_SIZE_BINS; i++) {
-        verticesBySize[i].reserve(estimatedVerticesPerBin);
-        colorsBySize[i].reserve(estimatedColorsPerBin);
+// what the splats were built for; anything different rebuilds them
+struct GasSplatKey {
+    const GasCloud* clouds = nullptr;
+    size_t count = 0;
+    unsigned long long generation = 0;
+    bool sprites = false;
+    int darkLaneLayers = -1;           // 0 when dark lanes aren't drawn
+    int numFilaments = 0, numLayersPerFilament = 0;
+    bool coronalHidden = false;
+
+    bool operator==(const GasSplatKey& other) const {
+        return clouds == other.clouds && count == other.count && generation == other.generation &&
+               sprites == other.sprites && darkLaneLayers == other.darkLaneLayers &&
+               numFilaments == other.numFilaments && numLayersPerFilament == other.numLayersPerFilament &&
+               coronalHidden == other.coronalHidden;
     }
+};
 
-    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+static GasSplatKey gasSplatKey;
+static GasSplatPass darkLaneSplats;
+static GasSplatPass emissiveSplats;
+
+// sprites only: each cloud's splat in its pass, -1 for clouds that aren't drawn
+static std::vector<int32_t> spriteOfCloud;
+
+// what of the clouds is in view this frame, and where they are
+static GasIndex gasIndex;
+static std::vector<uint32_t> visibleClouds;
+static std::vector<float> visibleCloudPositions;   // x and z at cloud * 2, of the visible ones
+
+static void startPass(GasSplatPass& pass) {
+    for (int i = 0; i < MAX_SIZE_BINS; i++) pass.pending[i].clear();
+}
+
+static void finishPass(GasSplatPass& pass, bool sprites) {
+    size_t total = 0;
+    for (int i = 0; i < MAX_SIZE_BINS; i++) total += pass.pending[i].size();
+
+    pass.clouds.resize(total);
+    pass.offsets.resize(total * 3);
+    pass.colors.resize(total * 4);
+    pass.shapes.resize(sprites ? total * 4 : 0);
+    pass.sprites.resize(sprites ? total : 0);
+
+    size_t splat = 0;
+    for (int sizeBin = 0; sizeBin < MAX_SIZE_BINS; sizeBin++) {
+        pass.binStart[sizeBin] = static_cast<int>(splat);
+
+        for (const PendingSplat& pending : pass.pending[sizeBin]) {
+            pass.clouds[splat] = pending.cloud;
+            std::copy(pending.offset, pending.offset + 3, &pass.offsets[splat * 3]);
+            std::copy(pending.color, pending.color + 4, &pass.colors[splat * 4]);
+            if (sprites) {
+                std::copy(pending.shape, pending.shape + 4, &pass.shapes[splat * 4]);
+                pass.sprites[splat] = pending.sprite;
+            }
+            splat++;
+        }
+
+        // the staging is only needed again when the zoom crosses a threshold
+        std::vector<PendingSplat>().swap(pass.pending[sizeBin]);
+    }
+    pass.binStart[MAX_SIZE_BINS] = static_cast<int>(splat);
+}
+
+// a sprite per cloud: dark lanes darken by their extinction at the centre, which the
+// point path's layers add up to with the sprite's peak
+static void buildGasSprites(const std::vector<GasCloud>& gasClouds, const GasSplatKey& key) {
+    for (size_t c = 0; c < gasClouds.size(); c++) {
+        const GasCloud& cloud = gasClouds[c];
+        const uint32_t cloudIndex = static_cast<uint32_t>(c);
+
+        if (cloud.isDarkLane) {
+            if (key.darkLaneLayers == 0) continue;
+
+            float extinction = cloud.alpha * 0.6f * cubicSplineKernel2D(0.0f, cloud.smoothingLength);
+            darkLaneSplats.addSprite(cloud, cloudIndex, 0.0f, 0.0f, 0.0f, extinction);
+        }
+        else {
+            if (key.coronalHidden && cloud.type == GasType::CORONAL) continue;
 
-    if (zone.zoomLevel >= 0.1) {
-        int numLayers = (zone.zoomLevel < 2.0) ? 3 : 4;
+            emissiveSplats.addSprite(cloud, cloudIndex, cloud.r, cloud.g, cloud.b, cloud.alpha * 0.8f);
+        }
+    }
+}
 
-        for (size_t idx = 0; idx < darkLaneIndices.size(); idx++) {
-            if (skipFactor > 1 && (idx % skipFactor) != 0) continue;
+static void buildGasLayers(const std::vector<GasCloud>& gasClouds, const GasSplatKey& key) {
+    for (size_t c = 0; c < gasClouds.size(); c++) {
+        const GasCloud& cloud = gasClouds[c];
+        const uint32_t cloudIndex = static_cast<uint32_t>(c);
 
-            const auto& cloud = gasClouds[darkLaneIndices[idx]];
+        if (cloud.isDarkLane) {
+            if (key.darkLaneLayers == 0) continue;
 
+            const int numLayers = key.darkLaneLayers;
             const float smoothingLength2x = cloud.smoothingLength * 2.0f;
             const float alphaW06 = cloud.alpha * 0.6f;
 
@@ -491,111 +807,457 @@ void renderGalacticGas(const std::vector<GasCloud>& gasClouds, const RenderZone&
                 float darken = 1.0f - extinction;
                 float size = smoothingLength2x * (1.0f + t * 0.3f);
 
-                int sizeBin = (int)(size / SIZE_BIN);
-                if (sizeBin < 0) sizeBin = 0;
-                if (sizeBin >= MAX_SIZE_BINS) sizeBin = MAX_SIZE_BINS - 1;
-
-                verticesBySize[sizeBin].push_back(cloud.x);
-                verticesBySize[sizeBin].push_back(cloud.y);
-                verticesBySize[sizeBin].push_back(cloud.z);
-
-                colorsBySize[sizeBin].push_back(darken);
-                colorsBySize[sizeBin].push_back(darken);
-                colorsBySize[sizeBin].push_back(darken);
-                colorsBySize[sizeBin].push_back(1.0f);
+                darkLaneSplats.add(size, cloudIndex, 0.0f, cloud.y, 0.0f, darken, darken, darken, 1.0f);
             }
         }
+        else {
+            if (key.coronalHidden && cloud.type == GasType::CORONAL) continue;
+
+            const int numFilaments = key.numFilaments;
+            const int numLayersPerFilament = key.numLayersPerFilament;
+            const float smoothingLength04 = cloud.smoothingLength * 0.4f;
+            const float cosRotation = cos(cloud.rotationAngle);
+            const float sinRotation = sin(cloud.rotationAngle);
+            const float baseSize = cloud.smoothingLength * 1.2f;
+            const float baseSizeElongated = baseSize * (1.0f + cloud.elongation * 0.5f);
+            const float alpha08 = cloud.alpha * 0.8f;
+            const int numFilamentsHalf = numFilaments / 2;
+
+            for (int f = 0; f < numFilaments; f++) {
+                const float filamentOffset = (f - numFilamentsHalf) * smoothingLength04;
+                const float offsetX = filamentOffset * cosRotation;
+                const float offsetZ = filamentOffset * sinRotation;
+                const float filamentFalloff = exp(-f * f * 0.8f);
+
+                for (int i = 0; i < numLayersPerFilament; i++) {
+                    float t = i / (float)(numLayersPerFilament - 1);
+
+                    float gaussian = exp(-t * t * 2.5f);
+                    float alpha = alpha08 * gaussian * filamentFalloff;
+
+                    float size = baseSizeElongated * (1.0f + t * 0.2f);
+
+                    emissiveSplats.add(size, cloudIndex, offsetX, cloud.y, offsetZ,
+                                       cloud.r, cloud.g, cloud.b, alpha);
+                }
+            }
+        }
+    }
+}
 
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_COLOR_ARRAY);
+static void buildGasSplats(const std::vector<GasCloud>& gasClouds, const GasSplatKey& key) {
+    startPass(darkLaneSplats);
+    startPass(emissiveSplats);
 
-        for (int sizeBin = 0; sizeBin < MAX_SIZE_BINS; sizeBin++) {
-            auto& vertices = verticesBySize[sizeBin];
-            auto& colors = colorsBySize[sizeBin];
+    if (key.sprites) buildGasSprites(gasClouds, key);
+    else buildGasLayers(gasClouds, key);
 
-            if (vertices.empty()) continue;
+    finishPass(darkLaneSplats, key.sprites);
+    finishPass(emissiveSplats, key.sprites);
+
+    spriteOfCloud.assign(key.sprites ? gasClouds.size() : 0, -1);
+    if (!key.sprites) return;
+    for (const GasSplatPass* pass : { &darkLaneSplats, &emissiveSplats }) {
+        for (size_t i = 0; i < pass->clouds.size(); i++) spriteOfCloud[pass->clouds[i]] = static_cast<int32_t>(i);
+    }
+}
 
-            glPointSize(sizeBin * SIZE_BIN);
-            glVertexPointer(3, GL_FLOAT, 0, vertices.data());
-            glColorPointer(4, GL_FLOAT, 0, colors.data());
-            glDrawArrays(GL_POINTS, 0, vertices.size() / 3);
+// The splats of the visible clouds moved to where the clouds are, packed in bin order so the
+// bins stay runs. The point path walks every splat, it is only the fallback
+static void packVisibleGasPoints(GasSplatPass& pass, const std::vector<uint8_t>& cloudVisible) {
+    pass.visibleVertices.clear();
+    pass.visibleColors.clear();
+
+    int count = 0;
+    for (int sizeBin = 0; sizeBin < MAX_SIZE_BINS; sizeBin++) {
+        pass.visibleBinStart[sizeBin] = count;
+        for (int i = pass.binStart[sizeBin]; i < pass.binStart[sizeBin + 1]; i++) {
+            uint32_t cloud = pass.clouds[i];
+            if (!cloudVisible[cloud]) continue;
+
+            const float* position = &visibleCloudPositions[cloud * 2];
+            const float* offset = &pass.offsets[i * 3];
+            pass.visibleVertices.push_back(position[0] + offset[0]);
+            pass.visibleVertices.push_back(offset[1]);
+            pass.visibleVertices.push_back(position[1] + offset[2]);
+            pass.visibleColors.insert(pass.visibleColors.end(), &pass.colors[i * 4], &pass.colors[i * 4 + 4]);
+            count++;
         }
+    }
+    pass.visibleBinStart[MAX_SIZE_BINS] = count;
+}
+
+static void drawGasSplatPoints(const GasSplatPass& pass) {
+    if (pass.visibleVertices.empty()) return;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, pass.visibleVertices.data());
+    glColorPointer(4, GL_FLOAT, 0, pass.visibleColors.data());
+
+    for (int sizeBin = 0; sizeBin < MAX_SIZE_BINS; sizeBin++) {
+        int first = pass.visibleBinStart[sizeBin];
+        int count = pass.visibleBinStart[sizeBin + 1] - first;
+        if (count == 0) continue;
 
-        glDisableClientState(GL_VERTEX_ARRAY);
-        glDisableClientState(GL_COLOR_ARRAY);
+        glPointSize(sizeBin * SIZE_BIN);
+        glDrawArrays(GL_POINTS, first, count);
     }
 
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+}
+
+static void renderGasSplatPoints(size_t cloudCount) {
+    static std::vector<uint8_t> cloudVisible;
+    cloudVisible.assign(cloudCount, 0);
+    for (uint32_t cloud : visibleClouds) cloudVisible[cloud] = 1;
+
+    packVisibleGasPoints(darkLaneSplats, cloudVisible);
+    packVisibleGasPoints(emissiveSplats, cloudVisible);
+
+    glEnable(GL_POINT_SMOOTH);
+
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    drawGasSplatPoints(darkLaneSplats);
+
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    drawGasSplatPoints(emissiveSplats);
+
+    glDisable(GL_POINT_SMOOTH);
+}
 
-    for (int i = 0; i < MAX_SIZE_BINS; i++) {
-        verticesBySize[i].clear();
-        colorsBySize[i].clear();
+// The billboards' buffers: the quad every instance is made of, and the sprites of the clouds
+// in view packed every frame, dark lanes first, as centre, shape, colour and atlas tile
+const size_t GAS_INSTANCE_FLOATS = 12;
+
+struct GasBillboards {
+    bool initialized = false;      // program creation tried
+    GLuint program = 0;            // 0 = draw points
+    GLint darkeningLocation = -1;
+    GLuint spriteTexture = 0;
+
+    GLuint cornerBuffer = 0;
+    StreamBuffer instances;
+    std::vector<uint32_t> visibleSprites[2];   // of the dark lanes and the emissive clouds
+};
+
+static GasBillboards gasBillboards;
+
+// The sprites can be drawn at 1/divisor of the window's resolution and scaled back up: the dark
+// lanes into one texture cleared to white, the emissive clouds into another cleared to black,
+// each composited with the blending its pass uses on the window. Gas is drawn without depth,
+// nothing in front of it has edges to keep, so the textures' bilinear filtering is the upsample
+struct GasTarget {
+    GLuint framebuffers[2] = {};
+    GLuint textures[2] = {};       // the dark lanes' factor, the emissive light
+    int width = 0, height = 0;
+    bool failed = false;           // couldn't be rendered to, the gas stays at full resolution
+};
+
+static GasTarget gasTarget;
+static int gasResolutionDivisor = 1;
+
+static void releaseGasTarget(GasTarget& target) {
+    if (target.framebuffers[0]) glDeleteFramebuffers(2, target.framebuffers);
+    if (target.textures[0]) glDeleteTextures(2, target.textures);
+    target = GasTarget();
+}
+
+// sizes the target for a viewport of width x height, false if there is none to draw into
+static bool prepareGasTarget(GasTarget& target, int width, int height) {
+    if (target.failed || !glFramebufferSupported()) return false;
+
+    int targetWidth = (width + gasResolutionDivisor - 1) / gasResolutionDivisor;
+    int targetHeight = (height + gasResolutionDivisor - 1) / gasResolutionDivisor;
+    if (target.framebuffers[0] && target.width == targetWidth && target.height == targetHeight) return true;
+
+    releaseGasTarget(target);
+    target.width = targetWidth;
+    target.height = targetHeight;
+
+    // half floats, the dark lanes take off less than an 8-bit step per cloud
+    glGenTextures(2, target.textures);
+    glGenFramebuffers(2, target.framebuffers);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, target.textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, targetWidth, targetHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffers[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) target.failed = true;
     }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (target.failed) {
+        std::cout << "Gas render target unavailable, drawing gas at full resolution" << std::endl;
+        releaseGasTarget(target);
+        target.failed = true;
+        return false;
+    }
+    return true;
+}
 
-    for (size_t idx = 0; idx < emissiveIndices.size(); idx++) {
-        if (skipFactor > 1 && (idx % skipFactor) != 0) continue;
+// makes one of the target's textures the one drawn to, cleared to value
+static void bindGasTarget(const GasTarget& target, int pass, float value) {
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
 
-        const auto& cloud = gasClouds[emissiveIndices[idx]];
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffers[pass]);
+    glClearColor(value, value, value, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        if (zone.zoomLevel < 0.001 && cloud.type == GasType::CORONAL) continue;
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
 
-        const float smoothingLength04 = cloud.smoothingLength * 0.4f;
-        const float cosRotation = cos(cloud.rotationAngle);
-        const float sinRotation = sin(cloud.rotationAngle);
-        const float baseSize = cloud.smoothingLength * 1.2f;
-        const float baseSizeElongated = baseSize * (1.0f + cloud.elongation * 0.5f);
-        const float alpha08 = cloud.alpha * 0.8f;
-        const int numFilamentsHalf = numFilaments / 2;
-
-        for (int f = 0; f < numFilaments; f++) {
-            const float filamentOffset = (f - numFilamentsHalf) * smoothingLength04;
-            const float offsetX = filamentOffset * cosRotation;
-            const float offsetZ = filamentOffset * sinRotation;
-            const float filamentFalloff = exp(-f * f * 0.8f);
+// both textures stretched over the viewport, blended the way their passes are drawn
+static void compositeGasTarget(const GasTarget& target) {
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 0) glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+        else glBlendFunc(GL_ONE, GL_ONE);
+
+        glBindTexture(GL_TEXTURE_2D, target.textures[pass]);
+        glBegin(GL_QUADS);
+        glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f, -1.0f);
+        glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, -1.0f);
+        glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, 1.0f);
+        glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f, 1.0f);
+        glEnd();
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
 
-            for (int i = 0; i < numLayersPerFilament; i++) {
-                float t = i / (float)(numLayersPerFilament - 1);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+}
 
-                float gaussian = exp(-t * t * 2.5f);
-                float alpha = alpha08 * gaussian * filamentFalloff;
+// one luminance tile per GasType
+static GLuint createGasSpriteTexture() {
+    std::vector<unsigned char> atlas(GAS_SPRITE_SIZE * GAS_SPRITE_TILES * GAS_SPRITE_SIZE, 0);
+    for (int t = 0; t < GAS_TYPE_COUNT; t++) {
+        gasSpritePeaks[t] = bakeGasSprite(static_cast<GasType>(t), t * GAS_SPRITE_SIZE, atlas);
+    }
 
-                float size = baseSizeElongated * (1.0f + t * 0.2f);
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, GAS_SPRITE_SIZE * GAS_SPRITE_TILES, GAS_SPRITE_SIZE, 0,
+                 GL_LUMINANCE, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the tiles fade to 0 at their rims, so neighbours never bleed into each other
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
 
-                int sizeBin = (int)(size / SIZE_BIN);
-                if (sizeBin < 0) sizeBin = 0;
-                if (sizeBin >= MAX_SIZE_BINS) sizeBin = MAX_SIZE_BINS - 1;
+static void initGasBillboards() {
+    GasBillboards& billboards = gasBillboards;
+    if (billboards.initialized) return;
 
-                verticesBySize[sizeBin].push_back(cloud.x + offsetX);
-                verticesBySize[sizeBin].push_back(cloud.y);
-                verticesBySize[sizeBin].push_back(cloud.z + offsetZ);
+    billboards.initialized = true;
+    if (!glInstancingSupported()) return;
 
-                colorsBySize[sizeBin].push_back(cloud.r);
-                colorsBySize[sizeBin].push_back(cloud.g);
-                colorsBySize[sizeBin].push_back(cloud.b);
-                colorsBySize[sizeBin].push_back(alpha);
-            }
+    billboards.program = createShaderProgram(GAS_VERTEX_SHADER, GAS_FRAGMENT_SHADER,
+                                             GAS_ATTRIBUTES, GAS_ATTRIBUTE_COUNT);
+    if (!billboards.program) {
+        std::cout << "Gas shader unavailable, drawing gas as points" << std::endl;
+        return;
+    }
+    billboards.darkeningLocation = glGetUniformLocation(billboards.program, "darkening");
+    billboards.spriteTexture = createGasSpriteTexture();
+
+    const float corners[8] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+    glGenBuffers(1, &billboards.cornerBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, billboards.cornerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// the visible clouds' sprites of each pass, in the order the index found the clouds
+static void findVisibleSprites(GasBillboards& billboards, const std::vector<GasCloud>& gasClouds) {
+    billboards.visibleSprites[0].clear();
+    billboards.visibleSprites[1].clear();
+    for (uint32_t cloud : visibleClouds) {
+        int32_t sprite = spriteOfCloud[cloud];
+        if (sprite < 0) continue;
+        billboards.visibleSprites[gasClouds[cloud].isDarkLane ? 0 : 1].push_back(static_cast<uint32_t>(sprite));
+    }
+}
+
+static void packGasInstances(const GasSplatPass& pass, const std::vector<uint32_t>& sprites, float* instances) {
+    parallelFor(g_threadPool, sprites.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t splat = sprites[i];
+            const float* position = &visibleCloudPositions[pass.clouds[splat] * 2];
+            const float* offset = &pass.offsets[splat * 3];
+            float* instance = &instances[i * GAS_INSTANCE_FLOATS];
+            instance[0] = position[0] + offset[0];
+            instance[1] = offset[1];
+            instance[2] = position[1] + offset[2];
+            std::copy(&pass.shapes[splat * 4], &pass.shapes[splat * 4 + 4], instance + 3);
+            std::copy(&pass.colors[splat * 4], &pass.colors[splat * 4 + 4], instance + 7);
+            instance[11] = pass.sprites[splat];
         }
+    });
+}
+
+// instances [first, first + count) of the frame as one draw
+static void drawGasBillboards(size_t instancesOffset, size_t first, size_t count) {
+    if (count == 0) return;
+
+    const GLsizei stride = static_cast<GLsizei>(GAS_INSTANCE_FLOATS * sizeof(float));
+    const size_t start = instancesOffset + first * GAS_INSTANCE_FLOATS * sizeof(float);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(start));
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(start + 3 * sizeof(float)));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(start + 7 * sizeof(float)));
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(start + 11 * sizeof(float)));
+
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, static_cast<GLsizei>(count));
+}
+
+// into gasTarget if offscreen, false if there was nothing to draw
+static bool renderGasBillboards(const std::vector<GasCloud>& gasClouds, bool offscreen) {
+    GasBillboards& billboards = gasBillboards;
+    findVisibleSprites(billboards, gasClouds);
+    const size_t darkLaneCount = billboards.visibleSprites[0].size();
+    const size_t emissiveCount = billboards.visibleSprites[1].size();
+    if (darkLaneCount + emissiveCount == 0) return false;
+
+    // packed straight into the stream
+    size_t bytes = (darkLaneCount + emissiveCount) * GAS_INSTANCE_FLOATS * sizeof(float);
+    float* instances = static_cast<float*>(beginStreamFrame(billboards.instances, bytes));
+    packGasInstances(darkLaneSplats, billboards.visibleSprites[0], instances);
+    packGasInstances(emissiveSplats, billboards.visibleSprites[1], instances + darkLaneCount * GAS_INSTANCE_FLOATS);
+    size_t instancesOffset = endStreamFrame(billboards.instances, bytes);
+
+    glUseProgram(billboards.program);
+    glBindTexture(GL_TEXTURE_2D, billboards.spriteTexture);
+    glBindBuffer(GL_ARRAY_BUFFER, billboards.cornerBuffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, billboards.instances.buffer);
+    for (int a = 0; a < GAS_ATTRIBUTE_COUNT; a++) {
+        glEnableVertexAttribArray(a);
+        if (a > 0) glVertexAttribDivisor(a, 1);
     }
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_COLOR_ARRAY);
+    glBlendFunc(GL_ZERO, GL_SRC_COLOR);
+    glUniform1f(billboards.darkeningLocation, 1.0f);
+    if (offscreen) bindGasTarget(gasTarget, 0, 1.0f);
+    drawGasBillboards(instancesOffset, 0, darkLaneCount);
 
-    for (int sizeBin = 0; sizeBin < MAX_SIZE_BINS; sizeBin++) {
-        auto& vertices = verticesBySize[sizeBin];
-        auto& colors = colorsBySize[sizeBin];
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    glUniform1f(billboards.darkeningLocation, 0.0f);
+    if (offscreen) bindGasTarget(gasTarget, 1, 0.0f);
+    drawGasBillboards(instancesOffset, darkLaneCount, emissiveCount);
+
+    // the star shader shares these attributes and reads them per vertex
+    for (int a = 0; a < GAS_ATTRIBUTE_COUNT; a++) {
+        if (a > 0) glVertexAttribDivisor(a, 0);
+        glDisableVertexAttribArray(a);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
 
-        if (vertices.empty()) continue;
+    fenceStreamFrame(billboards.instances);
+    return true;
+}
 
-        glPointSize(sizeBin * SIZE_BIN);
-        glVertexPointer(3, GL_FLOAT, 0, vertices.data());
-        glColorPointer(4, GL_FLOAT, 0, colors.data());
-        glDrawArrays(GL_POINTS, 0, vertices.size() / 3);
+const char* gasRendererName() {
+    initGasBillboards();
+    return gasBillboards.program ? "instanced sprites" : "point size bins";
+}
+
+void setGasResolutionDivisor(int divisor) {
+    gasResolutionDivisor = std::max(divisor, 1);
+}
+
+void renderGalacticGas(const std::vector<GasCloud>& gasClouds, double time, const RenderZone& zone) {
+    glEnable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    initGasBillboards();
+
+    // LOD based on zoom; sprites have every layer baked in, so only the points have levels
+    GasSplatKey key;
+    key.clouds = gasClouds.data();
+    key.count = gasClouds.size();
+    key.generation = gasCloudsGeneration.load();
+    key.sprites = gasBillboards.program != 0;
+    key.darkLaneLayers = (zone.zoomLevel < 0.1) ? 0 : (zone.zoomLevel < 2.0) ? 3 : 4;
+    key.numFilaments = 3;
+    key.numLayersPerFilament = 4;
+    if (zone.zoomLevel < 0.5) {
+        key.numFilaments = 2;
+        key.numLayersPerFilament = 3;
+    }
+    if (key.sprites) {
+        key.darkLaneLayers = std::min(key.darkLaneLayers, 1);
+        key.numFilaments = key.numLayersPerFilament = 0;
     }
+    key.coronalHidden = zone.zoomLevel < 0.001;
 
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
+    if (!(key == gasSplatKey)) {
+        buildGasSplats(gasClouds, key);
+        gasSplatKey = key;
+    }
+
+    // at reduced resolution the viewport is the target's, the frustum's pixels are too
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const bool offscreen = key.sprites && gasResolutionDivisor > 1 &&
+                           prepareGasTarget(gasTarget, viewport[2], viewport[3]);
+    if (offscreen) glViewport(0, 0, gasTarget.width, gasTarget.height);
+
+    // Only the clouds in view are moved and drawn. Sprites shrink with distance, so the ones under
+    // a pixel go too; points keep their pixel sizes however far away, only the frustum culls them
+    updateGasIndex(gasIndex, gasClouds, key.generation, time);
+    findVisibleGasClouds(gasIndex, gasClouds, currentViewFrustum(), time,
+                         key.sprites ? GAS_MIN_SPRITE_PIXELS : 0.0f, visibleClouds, visibleCloudPositions);
+
+    if (key.sprites) {
+        bool drawn = renderGasBillboards(gasClouds, offscreen);
+        if (offscreen) {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+            if (drawn) compositeGasTarget(gasTarget);
+        }
+    }
+    else renderGasSplatPoints(gasClouds.size());
 
-    glDisable(GL_POINT_SMOOTH);
     glEnable(GL_DEPTH_TEST);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
+
+void releaseGasRenderer() {
+    GasBillboards& billboards = gasBillboards;
+    if (billboards.program) glDeleteProgram(billboards.program);
+    if (billboards.cornerBuffer) glDeleteBuffers(1, &billboards.cornerBuffer);
+    if (billboards.spriteTexture) glDeleteTextures(1, &billboards.spriteTexture);
+    releaseStreamBuffer(billboards.instances);
+    billboards = GasBillboards();
+    releaseGasTarget(gasTarget);
+
+    gasIndex = GasIndex();
+}
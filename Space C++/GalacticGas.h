@@ -2,6 +2,7 @@
 #include <vector>
 
 struct RenderZone;
+struct SpiralArmField;
 
 enum class GasType {
     MOLECULAR,
@@ -23,12 +24,13 @@ struct GasCloud {
     float r, g, b;
     float alpha;
 
+    // x and z above are the position at time 0, the cloud orbits from there
     float orbitalRadius;     // distance from galactic center
-    float angle;             // current angle in XZ plane
+    float angle;             // angle in XZ plane at time 0
     float angularVelocity;   // rotation speed (radians per second)
 
     // turbulence = random small-scale motion
-    float turbulencePhase;   // random phase for animated turbulence
+    float turbulencePhase;   // random phase at time 0 for animated turbulence
     float turbulenceSpeed;   // how fast the turbulence evolves
 
     bool isDarkLane;         // true for molecular clouds that absorb light (render as dark)
@@ -55,10 +57,31 @@ struct GasConfig {
 };
 
 GasConfig createDefaultGasConfig();
+// SPH cubic spline in 2D, zero from r = 2h out; dark lanes are shaded with it
+float cubicSplineKernel2D(float r, float h);
 
-void generateGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& config, unsigned int seed, double diskRadius, double bulgeRadius);
-void updateGalacticGas(std::vector<GasCloud>& gasClouds, double deltaTime);
-void renderGalacticGas(const std::vector<GasCloud>& gasClouds, const RenderZone& zone);
+void generateGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& config, unsigned int seed, double diskRadius, double bulgeRadius, const SpiralArmField& armField);
+// gasClouds holds what previousConfig generated (unanimated) for the same galaxy. Each population
+// keeps its clouds up to the new count and only generates the ones it is missing.
+void extendGalacticGas(std::vector<GasCloud>& gasClouds, const GasConfig& previousConfig, const GasConfig& config, unsigned int seed, double diskRadius, double bulgeRadius, const SpiralArmField& armField);
+// Generating and extending call this themselves; anything else that writes the clouds of a
+// vector being drawn must too, the renderer keeps what it built from them until then
+void markGasCloudsChanged();
+// true if the two configs produce the same clouds apart from the population counts
+bool galacticGasCompatible(const GasConfig& a, const GasConfig& b);
+// how far a cloud's splats reach from its centre, world units; it is bounded by a sphere of it
+float gasCloudReach(const GasCloud& cloud);
+// x and z per cloud where its orbit puts it at the given simulation time, y doesn't change
+void computeGasCloudPositions(const std::vector<GasCloud>& gasClouds, double time, std::vector<float>& positions);
+// clouds are drawn where their orbits put them at the given simulation time
+void renderGalacticGas(const std::vector<GasCloud>& gasClouds, double time, const RenderZone& zone);
+// how renderGalacticGas draws on this context, compiling the gas shader on first use
+const char* gasRendererName();
+// Draws the gas sprites at 1/divisor of the viewport's resolution and scales them back up,
+// where the context can render to textures; 1 (the default) draws them at full resolution
+void setGasResolutionDivisor(int divisor);
+// the gas shader and buffers, while the context is still current
+void releaseGasRenderer();
 
 const float MOLECULAR_TEMP = 20.0f;          // 10-50 K
 const float COLD_NEUTRAL_TEMP = 80.0f;       // 50-100 K
@@ -0,0 +1,154 @@
+#include "GalaxyBuilder.h"
+#include "GalaxySnapshot.h"
+#include "SpiralArmField.h"
+#include <iostream>
+
+static bool isCancelled(const std::atomic<bool>* cancel) {
+	return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+bool buildGalaxy(const GalaxyConfig& galaxyConfig, const GasConfig& gasConfig,
+	const BlackHoleConfig& blackHoleConfig, GalaxyScene& scene, const GalaxySceneConfigs* previous,
+	const std::atomic<bool>* cancel, const StarChunkCallback& onStarChunk) {
+	uint64_t configHash = hashGalaxyConfigs(galaxyConfig, gasConfig, blackHoleConfig);
+	std::string snapshotPath = galaxySnapshotPath(configHash);
+
+	if (loadGalaxySnapshot(snapshotPath, configHash, scene.stars, scene.gasClouds, scene.blackHoles)) {
+		std::cout << "Galaxy loaded from " << snapshotPath << std::endl;
+		return true;
+	}
+
+	SpiralArmField armField;
+	buildSpiralArmField(armField, galaxyConfig);
+
+	// every population is prefix-stable, so when only counts changed the existing
+	// stars and clouds are kept and just the difference is generated or dropped
+	bool sameGalaxy = previous && starFieldCompatible(previous->galaxy, galaxyConfig);
+
+	if (sameGalaxy) {
+		// no preview here, it would replace the kept stars with only the new ones
+		extendStarField(scene.stars, galaxyConfig, armField, cancel);
+	}
+	else {
+		generateStarField(scene.stars, galaxyConfig, armField, cancel, onStarChunk);
+	}
+	if (isCancelled(cancel)) return false;
+
+	generateBlackHoles(scene.blackHoles, blackHoleConfig, galaxyConfig.seed,
+		galaxyConfig.diskRadius, galaxyConfig.bulgeRadius);
+
+	if (sameGalaxy && galacticGasCompatible(previous->gas, gasConfig)) {
+		extendGalacticGas(scene.gasClouds, previous->gas, gasConfig, galaxyConfig.seed,
+			galaxyConfig.diskRadius, galaxyConfig.bulgeRadius, armField);
+	}
+	else {
+		generateGalacticGas(scene.gasClouds, gasConfig, galaxyConfig.seed,
+			galaxyConfig.diskRadius, galaxyConfig.bulgeRadius, armField);
+	}
+	if (isCancelled(cancel)) return false;
+
+	saveGalaxySnapshot(snapshotPath, configHash, scene.stars, scene.gasClouds, scene.blackHoles);
+	return true;
+}
+
+void startGalaxyBuild(GalaxyBuilder& builder, const GalaxyScene& shown, const GalaxyConfig& galaxyConfig,
+	const GasConfig& gasConfig, const BlackHoleConfig& blackHoleConfig) {
+	cancelGalaxyBuild(builder);
+
+	builder.cancelRequested.store(false);
+	builder.finished.store(false);
+	builder.publishedChunks.clear();
+	builder.previewStarted = false;
+
+	builder.buildingConfigs.galaxy = galaxyConfig;
+	builder.buildingConfigs.gas = gasConfig;
+
+	// only counts changed since the shown build: extend a copy of it
+	bool extend = builder.showingCompleteBuild &&
+		starFieldCompatible(builder.shownConfigs.galaxy, galaxyConfig);
+	GalaxySceneConfigs previous = builder.shownConfigs;
+
+	// an extended field has no preview, the shown one is already most of it
+	StarChunkCallback onStarChunk;
+	if (!extend && galaxyConfig.numStars >= GALAXY_PREVIEW_MIN_STARS) {
+		onStarChunk = [&builder](int firstStar, int count) {
+			std::lock_guard<std::mutex> lock(builder.previewMutex);
+			builder.publishedChunks.push_back({ firstStar, count });
+			};
+	}
+
+	// configs are copied, the UI is free to change them while we build.
+	// shown stays untouched until the swap: nothing animates it, and without a preview
+	// the main loop leaves it alone
+	builder.worker = std::thread([&builder, &shown, extend, previous, galaxyConfig, gasConfig,
+		blackHoleConfig, onStarChunk]() {
+		if (extend) {
+			// assigning reuses the back buffer's storage from the last swap
+			builder.back.stars = shown.stars;
+			builder.back.gasClouds = shown.gasClouds;
+		}
+
+		bool completed = buildGalaxy(galaxyConfig, gasConfig, blackHoleConfig, builder.back,
+			extend ? &previous : nullptr, &builder.cancelRequested, onStarChunk);
+
+		if (completed) {
+			builder.finished.store(true, std::memory_order_release);
+		}
+		});
+}
+
+bool swapFinishedGalaxy(GalaxyBuilder& builder, GalaxyScene& scene) {
+	if (!builder.finished.load(std::memory_order_acquire)) return false;
+
+	if (builder.worker.joinable()) builder.worker.join();
+	builder.finished.store(false);
+	builder.publishedChunks.clear();
+	builder.previewStarted = false;
+
+	std::swap(scene.stars, builder.back.stars);
+	std::swap(scene.blackHoles, builder.back.blackHoles);
+	std::swap(scene.gasClouds, builder.back.gasClouds);
+
+	builder.shownConfigs = builder.buildingConfigs;
+	builder.showingCompleteBuild = true;
+	return true;
+}
+
+bool updateGalaxyPreview(GalaxyBuilder& builder, GalaxyScene& scene) {
+	std::vector<StarChunkRange> chunks;
+	{
+		std::lock_guard<std::mutex> lock(builder.previewMutex);
+		chunks.swap(builder.publishedChunks);
+	}
+	if (chunks.empty()) return false;
+
+	if (!builder.previewStarted) {
+		scene.stars.clear();
+		builder.previewStarted = true;
+		builder.showingCompleteBuild = false;
+	}
+
+	// published chunks are never written again, and the mutex orders their writes before these reads
+	for (const auto& chunk : chunks) {
+		scene.stars.append(builder.back.stars, chunk.firstStar, chunk.count);
+	}
+	return true;
+}
+
+bool isGalaxyBuildRunning(const GalaxyBuilder& builder) {
+	return builder.worker.joinable() && !builder.finished.load(std::memory_order_acquire);
+}
+
+void waitForGalaxyBuild(GalaxyBuilder& builder) {
+	if (builder.worker.joinable()) builder.worker.join();
+}
+
+void cancelGalaxyBuild(GalaxyBuilder& builder) {
+	if (!builder.worker.joinable()) return;
+
+	// the star generator checks this between chunks, so the join is short
+	builder.cancelRequested.store(true);
+	builder.worker.join();
+	builder.finished.store(false);
+	builder.publishedChunks.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "Stars.h"
+#include "GalacticGas.h"
+#include "BlackHole.h"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+// Everything that gets regenerated when the galaxy parameters change
+struct GalaxyScene {
+	StarField stars;
+	std::vector<BlackHole> blackHoles;
+	std::vector<GasCloud> gasClouds;
+};
+
+// The configs a scene was generated from
+struct GalaxySceneConfigs {
+	GalaxyConfig galaxy;
+	GasConfig gas;
+};
+
+// Builds at least this many stars get a progressive preview while they generate
+const int GALAXY_PREVIEW_MIN_STARS = 250000;
+
+struct StarChunkRange {
+	int firstStar;
+	int count;
+};
+
+// Builds a new scene on a worker thread while the current one keeps animating.
+// The worker fills the back buffer, the main loop swaps it in at a frame boundary.
+// Big star fields are also published chunk by chunk as a preview until they finish.
+//
+// Animating doesn't write to the scene, so a build that only changes counts starts
+// from a copy of the shown scene and extends or truncates it instead of starting over.
+struct GalaxyBuilder {
+	std::thread worker;
+	std::atomic<bool> cancelRequested{ false };
+	std::atomic<bool> finished{ false };
+
+	GalaxyScene back;
+
+	// main thread only
+	GalaxySceneConfigs buildingConfigs;		// what the running build generates
+	GalaxySceneConfigs shownConfigs;		// what the shown scene was generated from
+	bool showingCompleteBuild = false;		// false while the scene is empty or a preview
+
+	std::mutex previewMutex;
+	std::vector<StarChunkRange> publishedChunks;	// finished chunks of back.stars not yet shown
+	bool previewStarted = false;					// main thread only
+};
+
+// Loads the galaxy from the snapshot cache if this exact config was generated before,
+// otherwise generates it and writes the snapshot for next time.
+// If previous is given, scene holds what it generated. Populations that
+// only changed in count are then extended or truncated rather than generated again.
+// Returns false if it was cancelled part way, in which case the scene is incomplete.
+bool buildGalaxy(const GalaxyConfig& galaxyConfig, const GasConfig& gasConfig,
+	const BlackHoleConfig& blackHoleConfig, GalaxyScene& scene,
+	const GalaxySceneConfigs* previous = nullptr,
+	const std::atomic<bool>* cancel = nullptr, const StarChunkCallback& onStarChunk = nullptr);
+
+// Starts building in the background. A build that is still running is cancelled, not queued.
+// shown is the scene the main loop draws; it may be read until the build is swapped in.
+void startGalaxyBuild(GalaxyBuilder& builder, const GalaxyScene& shown, const GalaxyConfig& galaxyConfig,
+	const GasConfig& gasConfig, const BlackHoleConfig& blackHoleConfig);
+
+// Call once per frame: if a build has finished, swaps it into scene and returns true.
+// The old scene's buffers become the back buffer for the next build.
+bool swapFinishedGalaxy(GalaxyBuilder& builder, GalaxyScene& scene);
+
+// Call once per frame while building: appends newly finished star chunks to scene.stars.
+// The first chunk of a build replaces the old stars, so a sparse preview of the new
+// galaxy shows up right away and fills in as the rest arrives.
+bool updateGalaxyPreview(GalaxyBuilder& builder, GalaxyScene& scene);
+
+bool isGalaxyBuildRunning(const GalaxyBuilder& builder);
+
+// Blocks until the running build is done. It still has to be swapped in.
+void waitForGalaxyBuild(GalaxyBuilder& builder);
+
+void cancelGalaxyBuild(GalaxyBuilder& builder);
@@ -0,0 +1,300 @@
+#include "GalaxySnapshot.h"
+#include "Random.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[4] = { 'G', 'S', 'N', 'P' };
+static const char* SNAPSHOT_DIRECTORY = "cache";
+
+// bytes per star over all StarField arrays
+static const size_t STAR_BYTES = 3 * sizeof(uint16_t) + 2 * sizeof(uint8_t);
+
+// calls visit on each StarField array in file order
+template <typename Field, typename Visitor>
+static void forEachStarArray(Field& stars, Visitor visit) {
+	visit(stars.radius);
+	visit(stars.angle);
+	visit(stars.height);
+	visit(stars.type);
+	visit(stars.brightness);
+}
+
+struct MappedFile {
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+};
+
+static bool mapFile(const std::string& path, MappedFile& mapped) {
+#ifdef _WIN32
+	mapped.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mapped.file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mapped.file, &size) || size.QuadPart == 0) return false;
+	mapped.size = static_cast<size_t>(size.QuadPart);
+
+	mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapped.mapping) return false;
+
+	mapped.data = static_cast<const unsigned char*>(MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0));
+	return mapped.data != nullptr;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	mapped.size = static_cast<size_t>(st.st_size);
+
+	void* data = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+
+	mapped.data = static_cast<const unsigned char*>(data);
+	return true;
+#endif
+}
+
+static void unmapFile(MappedFile& mapped) {
+#ifdef _WIN32
+	if (mapped.data) UnmapViewOfFile(mapped.data);
+	if (mapped.mapping) CloseHandle(mapped.mapping);
+	if (mapped.file != INVALID_HANDLE_VALUE) CloseHandle(mapped.file);
+#else
+	if (mapped.data) munmap(const_cast<unsigned char*>(mapped.data), mapped.size);
+#endif
+	mapped = MappedFile();
+}
+
+// Four independent multiply-xor lanes over 64-bit words, fast enough to verify
+// a few hundred MB without showing up in the load time
+static uint64_t checksumBytes(const unsigned char* data, size_t size) {
+	const uint64_t PRIME = 0xFF51AFD7ED558CCDull;
+	uint64_t lanes[4] = { 1, 2, 3, 4 };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		for (int l = 0; l < 4; l++) {
+			uint64_t word;
+			memcpy(&word, data + i + l * 8, 8);
+			lanes[l] = (lanes[l] ^ word) * PRIME;
+			lanes[l] ^= lanes[l] >> 29;
+		}
+	}
+
+	uint64_t h = mixSeed(size);
+	for (int l = 0; l < 4; l++) h = mixSeed(h ^ lanes[l]);
+	for (; i < size; i++) h = mixSeed(h ^ data[i]);
+	return h;
+}
+
+static void hashValue(uint64_t& h, uint64_t bits) {
+	h = mixSeed(h ^ bits);
+}
+
+static void hashValue(uint64_t& h, double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	hashValue(h, bits);
+}
+
+static void hashValue(uint64_t& h, float value) {
+	hashValue(h, static_cast<double>(value));
+}
+
+uint64_t hashGalaxyConfigs(const GalaxyConfig& galaxyConfig, const GasConfig& gasConfig,
+	const BlackHoleConfig& blackHoleConfig) {
+	uint64_t h = GALAXY_SNAPSHOT_VERSION;
+
+	// numThreads is left out on purpose, the output doesn't depend on it
+	hashValue(h, static_cast<uint64_t>(galaxyConfig.seed));
+	hashValue(h, static_cast<uint64_t>(galaxyConfig.numStars));
+	hashValue(h, static_cast<uint64_t>(galaxyConfig.numSpiralArms));
+	hashValue(h, galaxyConfig.spiralTightness);
+	hashValue(h, galaxyConfig.armWidth);
+	hashValue(h, galaxyConfig.diskRadius);
+	hashValue(h, galaxyConfig.bulgeRadius);
+	hashValue(h, galaxyConfig.diskHeight);
+	hashValue(h, galaxyConfig.bulgeHeight);
+	hashValue(h, galaxyConfig.armDensityBoost);
+	hashValue(h, galaxyConfig.rotationSpeed);
+
+	hashValue(h, static_cast<uint64_t>(gasConfig.numMolecularClouds));
+	hashValue(h, static_cast<uint64_t>(gasConfig.numColdNeutralClouds));
+	hashValue(h, static_cast<uint64_t>(gasConfig.numWarmNeutralClouds));
+	hashValue(h, static_cast<uint64_t>(gasConfig.numWarmIonizedClouds));
+	hashValue(h, static_cast<uint64_t>(gasConfig.numHotIonizedClouds));
+	hashValue(h, static_cast<uint64_t>(gasConfig.numCoronalClouds));
+	hashValue(h, gasConfig.molecularScaleHeight);
+	hashValue(h, gasConfig.neutralScaleHeight);
+	hashValue(h, gasConfig.ionizedScaleHeight);
+	hashValue(h, gasConfig.coronalScaleHeight);
+	hashValue(h, static_cast<uint64_t>(gasConfig.enableTurbulence));
+	hashValue(h, static_cast<uint64_t>(gasConfig.enableDensityWaves));
+
+	hashValue(h, static_cast<uint64_t>(blackHoleConfig.enableSupermassive));
+	hashValue(h, blackHoleConfig.supermassiveMass);
+
+	return h;
+}
+
+std::string galaxySnapshotPath(uint64_t configHash) {
+	std::stringstream ss;
+	ss << SNAPSHOT_DIRECTORY << "/galaxy_" << std::hex << std::setw(16) << std::setfill('0') << configHash << ".snap";
+	return ss.str();
+}
+
+// takes count elements of elementSize bytes off the bytes remaining, false if there aren't that
+// many; counts come from the file, so they are bounded before they are multiplied
+static bool takeElements(uint64_t count, size_t elementSize, size_t& remaining) {
+	if (count > remaining / elementSize) return false;
+	remaining -= static_cast<size_t>(count) * elementSize;
+	return true;
+}
+
+bool loadGalaxySnapshot(const std::string& path, uint64_t configHash, StarField& stars,
+	std::vector<GasCloud>& gasClouds, std::vector<BlackHole>& blackHoles) {
+	MappedFile mapped;
+	if (!mapFile(path, mapped)) {
+		unmapFile(mapped);
+		return false;
+	}
+
+	bool valid = mapped.size >= sizeof(SnapshotHeader);
+
+	SnapshotHeader header;
+	if (valid) {
+		memcpy(&header, mapped.data, sizeof(header));
+
+		valid = memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+			header.version == GALAXY_SNAPSHOT_VERSION &&
+			header.configHash == configHash &&
+			header.starSize == STAR_BYTES &&
+			header.gasCloudSize == sizeof(GasCloud) &&
+			header.blackHoleSize == sizeof(BlackHole) &&
+			mapped.size >= sizeof(SnapshotHeader) + sizeof(StarFieldScale);
+	}
+	if (valid) {
+		size_t remaining = mapped.size - sizeof(SnapshotHeader) - sizeof(StarFieldScale);
+		valid = takeElements(header.starCount, STAR_BYTES, remaining) &&
+			takeElements(header.gasCloudCount, sizeof(GasCloud), remaining) &&
+			takeElements(header.blackHoleCount, sizeof(BlackHole), remaining) &&
+			remaining == 0;
+	}
+
+	const unsigned char* payload = mapped.data + sizeof(SnapshotHeader);
+	size_t payloadSize = mapped.size - sizeof(SnapshotHeader);
+
+	if (valid) {
+		valid = checksumBytes(payload, payloadSize) == header.checksum;
+	}
+
+	if (!valid) {
+		std::cout << "Discarding stale galaxy snapshot " << path << std::endl;
+		unmapFile(mapped);
+		return false;
+	}
+
+	memcpy(&stars.scale, payload, sizeof(StarFieldScale));
+	const unsigned char* starData = payload + sizeof(StarFieldScale);
+
+	// resized through the field, so it counts as new stars
+	stars.resize(header.starCount);
+	forEachStarArray(stars, [&](auto& array) {
+		size_t bytes = array.size() * sizeof(array[0]);
+		if (bytes) memcpy(array.data(), starData, bytes);
+		starData += bytes;
+		});
+
+	const GasCloud* gasData = reinterpret_cast<const GasCloud*>(starData);
+	const BlackHole* blackHoleData = reinterpret_cast<const BlackHole*>(gasData + header.gasCloudCount);
+
+	gasClouds.assign(gasData, gasData + header.gasCloudCount);
+	markGasCloudsChanged();
+	blackHoles.assign(blackHoleData, blackHoleData + header.blackHoleCount);
+
+	unmapFile(mapped);
+	return true;
+}
+
+bool saveGalaxySnapshot(const std::string& path, uint64_t configHash, const StarField& stars,
+	const std::vector<GasCloud>& gasClouds, const std::vector<BlackHole>& blackHoles) {
+#ifdef _WIN32
+	CreateDirectoryA(SNAPSHOT_DIRECTORY, nullptr);
+#else
+	mkdir(SNAPSHOT_DIRECTORY, 0755);
+#endif
+
+	SnapshotHeader header = {};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = GALAXY_SNAPSHOT_VERSION;
+	header.configHash = configHash;
+	header.starSize = STAR_BYTES;
+	header.gasCloudSize = sizeof(GasCloud);
+	header.blackHoleSize = sizeof(BlackHole);
+	header.starCount = stars.size();
+	header.gasCloudCount = gasClouds.size();
+	header.blackHoleCount = blackHoles.size();
+
+	// the arrays are contiguous in the file but not in memory, so the checksum runs over a copy
+	std::vector<unsigned char> payload(sizeof(StarFieldScale) + stars.size() * STAR_BYTES +
+		gasClouds.size() * sizeof(GasCloud) + blackHoles.size() * sizeof(BlackHole));
+	unsigned char* out = payload.data();
+	memcpy(out, &stars.scale, sizeof(StarFieldScale));
+	out += sizeof(StarFieldScale);
+	forEachStarArray(stars, [&](const auto& array) {
+		size_t bytes = array.size() * sizeof(array[0]);
+		if (bytes) memcpy(out, array.data(), bytes);
+		out += bytes;
+		});
+	if (!gasClouds.empty()) memcpy(out, gasClouds.data(), gasClouds.size() * sizeof(GasCloud));
+	out += gasClouds.size() * sizeof(GasCloud);
+	if (!blackHoles.empty()) memcpy(out, blackHoles.data(), blackHoles.size() * sizeof(BlackHole));
+
+	header.checksum = checksumBytes(payload.data(), payload.size());
+
+	// write next to the target and rename, so a crash never leaves a half-written cache behind
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::cerr << "Failed to write galaxy snapshot " << tempPath << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+		if (!file) {
+			std::cerr << "Failed to write galaxy snapshot " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Stars.h"
+#include "GalacticGas.h"
+#include "BlackHole.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary snapshot of a generated galaxy, so a known seed loads in milliseconds
+// instead of being regenerated on every launch.
+//
+// Layout: SnapshotHeader, then the StarFieldScale, the StarField arrays, the GasCloud and
+// the BlackHole arrays back to back, exactly as they sit in memory. Loading maps the file
+// and copies the arrays out.
+
+// bump whenever the file layout or anything in the generators changes,
+// otherwise old caches would be loaded for configs that now generate differently
+const uint32_t GALAXY_SNAPSHOT_VERSION = 5;
+
+struct SnapshotHeader {
+	char magic[4];			// "GSNP"
+	uint32_t version;
+	uint64_t configHash;
+
+	// guards against loading a file written by a build with a different struct layout
+	uint32_t starSize;		// bytes per star over all StarField arrays
+	uint32_t gasCloudSize;
+	uint32_t blackHoleSize;
+	uint32_t reserved;
+
+	uint64_t starCount;
+	uint64_t gasCloudCount;
+	uint64_t blackHoleCount;
+
+	uint64_t checksum;		// over everything after the header
+};
+
+// Hash of everything that affects generation (the seed lives in GalaxyConfig)
+uint64_t hashGalaxyConfigs(const GalaxyConfig& galaxyConfig, const GasConfig& gasConfig,
+	const BlackHoleConfig& blackHoleConfig);
+
+std::string galaxySnapshotPath(uint64_t configHash);
+
+// Returns false if the file is missing, from another version, for another config or corrupt.
+bool loadGalaxySnapshot(const std::string& path, uint64_t configHash, StarField& stars,
+	std::vector<GasCloud>& gasClouds, std::vector<BlackHole>& blackHoles);
+
+bool saveGalaxySnapshot(const std::string& path, uint64_t configHash, const StarField& stars,
+	const std::vector<GasCloud>& gasClouds, const std::vector<BlackHole>& blackHoles);
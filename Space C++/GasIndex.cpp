@@ -0,0 +1,220 @@
+#include "GasIndex.h"
+#include "Camera.h"
+#include "ThreadPool.h"
+#include "OrbitKernels.h"
+#include <algorithm>
+#include <cmath>
+
+static bool isHaloCloud(const GasCloud& cloud) {
+	return cloud.type == GasType::CORONAL;
+}
+
+// sorts the annulus' span of order into its bins by the clouds' angles at `time`
+static void binAnnulus(GasIndex& index, int a, const std::vector<GasCloud>& gasClouds, double time) {
+	OrbitAnnulus& annulus = index.annuli[a];
+	uint32_t* span = &index.order[annulus.first];
+	annulus.binnedTime = time;
+
+	std::vector<uint32_t> sorted(annulus.count);
+	std::vector<uint16_t> bins(annulus.count);
+	uint32_t counts[ORBIT_INDEX_BINS] = {};
+
+	for (uint32_t i = 0; i < annulus.count; i++) {
+		const GasCloud& cloud = gasClouds[span[i]];
+		double turns = annulusTurns(annulus, cloud.angle, cloud.angularVelocity, time);
+		bins[i] = static_cast<uint16_t>(annulusBin(annulus, turns, cloud.y));
+		counts[bins[i]]++;
+	}
+
+	uint32_t* binStart = &index.binStart[a * ORBIT_INDEX_BINS];
+	float* binReach = &index.binReach[a * ORBIT_INDEX_BINS];
+	uint32_t offset = 0;
+	for (int b = 0; b < ORBIT_INDEX_BINS; b++) {
+		binStart[b] = annulus.first + offset;
+		offset += counts[b];
+		counts[b] = binStart[b] - annulus.first;
+		binReach[b] = 0.0f;
+	}
+	for (uint32_t i = 0; i < annulus.count; i++) {
+		sorted[counts[bins[i]]++] = span[i];
+		binReach[bins[i]] = std::max(binReach[bins[i]], gasCloudReach(gasClouds[span[i]]));
+	}
+
+	std::copy(sorted.begin(), sorted.end(), span);
+}
+
+static void buildGasIndex(GasIndex& index, const std::vector<GasCloud>& gasClouds, double time) {
+	const int numAnnuli = GAS_INDEX_DISK_ANNULI + GAS_INDEX_HALO_ANNULI;
+
+	// each family by orbital radius, then cut into annuli of about equal cloud counts
+	std::vector<uint32_t> family[2];
+	for (size_t i = 0; i < gasClouds.size(); i++) {
+		family[isHaloCloud(gasClouds[i]) ? 1 : 0].push_back(static_cast<uint32_t>(i));
+	}
+
+	index.order.clear();
+	index.order.reserve(gasClouds.size());
+	index.annuli.assign(numAnnuli, OrbitAnnulus());
+	for (int f = 0; f < 2; f++) {
+		std::vector<uint32_t>& members = family[f];
+		std::sort(members.begin(), members.end(), [&](uint32_t a, uint32_t b) {
+			return gasClouds[a].orbitalRadius < gasClouds[b].orbitalRadius;
+			});
+
+		int firstAnnulus = f == 0 ? 0 : GAS_INDEX_DISK_ANNULI;
+		int familyAnnuli = f == 0 ? GAS_INDEX_DISK_ANNULI : GAS_INDEX_HALO_ANNULI;
+		for (int k = 0; k < familyAnnuli; k++) {
+			OrbitAnnulus& annulus = index.annuli[firstAnnulus + k];
+			size_t begin = members.size() * k / familyAnnuli;
+			size_t end = members.size() * (k + 1) / familyAnnuli;
+			annulus.first = static_cast<uint32_t>(index.order.size());
+			annulus.count = static_cast<uint32_t>(end - begin);
+			annulus.innerRadius = annulus.outerRadius = 0.0f;
+			annulus.minHeight = annulus.maxHeight = 0.0f;
+			annulus.meanAngularVelocity = 0.0;
+			annulus.maxDrift = 0.0;
+			if (begin == end) continue;
+
+			float minVelocity = 1e30f, maxVelocity = -1e30f;
+			annulus.innerRadius = gasClouds[members[begin]].orbitalRadius;
+			annulus.outerRadius = gasClouds[members[end - 1]].orbitalRadius;
+			annulus.minHeight = annulus.maxHeight = gasClouds[members[begin]].y;
+			for (size_t i = begin; i < end; i++) {
+				const GasCloud& cloud = gasClouds[members[i]];
+				annulus.minHeight = std::min(annulus.minHeight, cloud.y);
+				annulus.maxHeight = std::max(annulus.maxHeight, cloud.y);
+				annulus.meanAngularVelocity += cloud.angularVelocity;
+				minVelocity = std::min(minVelocity, cloud.angularVelocity);
+				maxVelocity = std::max(maxVelocity, cloud.angularVelocity);
+				index.order.push_back(members[i]);
+			}
+			annulus.meanAngularVelocity /= annulus.count;
+			annulus.maxDrift = std::max(maxVelocity - annulus.meanAngularVelocity,
+				annulus.meanAngularVelocity - minVelocity);
+		}
+	}
+
+	index.binStart.resize(numAnnuli * ORBIT_INDEX_BINS + 1);
+	index.binStart[numAnnuli * ORBIT_INDEX_BINS] = static_cast<uint32_t>(gasClouds.size());
+	index.binReach.resize(numAnnuli * ORBIT_INDEX_BINS);
+	parallelFor(g_threadPool, numAnnuli, 1, [&](size_t begin, size_t end) {
+		for (size_t a = begin; a < end; a++) {
+			binAnnulus(index, static_cast<int>(a), gasClouds, time);
+		}
+		});
+}
+
+void updateGasIndex(GasIndex& index, const std::vector<GasCloud>& gasClouds, unsigned long long generation,
+	double time) {
+	if (gasClouds.data() != index.clouds || gasClouds.size() != index.count || generation != index.generation) {
+		buildGasIndex(index, gasClouds, time);
+		index.clouds = gasClouds.data();
+		index.count = gasClouds.size();
+		index.generation = generation;
+		return;
+	}
+
+	std::vector<int> drifted;
+	for (int a = 0; a < static_cast<int>(index.annuli.size()); a++) {
+		if (annulusDrifted(index.annuli[a], time)) drifted.push_back(a);
+	}
+
+	parallelFor(g_threadPool, drifted.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			binAnnulus(index, drifted[i], gasClouds, time);
+		}
+		});
+}
+
+// true if something of the given reach as near as the sphere can come would be too small to see
+static bool tooSmallToSee(const ViewFrustum& frustum, double x, double y, double z, double radius,
+	double reach, float minPixels) {
+	double dx = x - frustum.eye[0], dy = y - frustum.eye[1], dz = z - frustum.eye[2];
+	double nearest = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+	return nearest > 0.0 && 2.0 * reach * frustum.pixelScale < minPixels * nearest;
+}
+
+// tests the clouds of one bin one by one, where their orbits put them at `time`
+static void findVisibleInBin(const GasIndex& index, const std::vector<GasCloud>& gasClouds,
+	const ViewFrustum& frustum, double time, float minPixels, uint32_t first, uint32_t count,
+	std::vector<uint32_t>& visible, std::vector<float>& positions) {
+	const uint32_t BLOCK = 256;
+	float radius[BLOCK], angle[BLOCK], angularVelocity[BLOCK];
+	float x[BLOCK], z[BLOCK];
+
+	for (uint32_t blockBegin = first; blockBegin < first + count; blockBegin += BLOCK) {
+		uint32_t blockCount = std::min(BLOCK, first + count - blockBegin);
+		for (uint32_t i = 0; i < blockCount; i++) {
+			const GasCloud& cloud = gasClouds[index.order[blockBegin + i]];
+			radius[i] = cloud.orbitalRadius;
+			angle[i] = cloud.angle;
+			angularVelocity[i] = cloud.angularVelocity;
+		}
+
+		computeOrbitXZ(radius, angle, angularVelocity, blockCount, time, x, z);
+
+		for (uint32_t i = 0; i < blockCount; i++) {
+			uint32_t c = index.order[blockBegin + i];
+			const GasCloud& cloud = gasClouds[c];
+			double reach = gasCloudReach(cloud) + ORBIT_INDEX_DISTANCE_MARGIN;
+			if (!sphereInFrustum(frustum, x[i], cloud.y, z[i], reach)) continue;
+			if (tooSmallToSee(frustum, x[i], cloud.y, z[i], 0.0, reach, minPixels)) continue;
+
+			positions[c * 2 + 0] = x[i];
+			positions[c * 2 + 1] = z[i];
+			visible.push_back(c);
+		}
+	}
+}
+
+// the visible clouds of one sector of annulus a
+static void findVisibleInSector(const GasIndex& index, const std::vector<GasCloud>& gasClouds,
+	const ViewFrustum& frustum, double time, float minPixels, size_t a, int sector,
+	std::vector<uint32_t>& visible, std::vector<float>& positions) {
+	const OrbitAnnulus& annulus = index.annuli[a];
+	const uint32_t* binStart = &index.binStart[a * ORBIT_INDEX_BINS];
+	const float* binReach = &index.binReach[a * ORBIT_INDEX_BINS];
+	int firstBin = sector * ORBIT_INDEX_SLABS;
+	if (binStart[firstBin] == binStart[firstBin + ORBIT_INDEX_SLABS]) return;
+
+	float sectorReach = 0.0f;
+	for (int slab = 0; slab < ORBIT_INDEX_SLABS; slab++) sectorReach = std::max(sectorReach, binReach[firstBin + slab]);
+	if (!annulusInFrustum(annulus, frustum, sectorReach)) return;
+
+	// the bounds hold the clouds' centres, their reach goes on top
+	SectorBounds bounds;
+	sectorBounds(annulus, sector, time, bounds);
+	double x = bounds.x, z = bounds.z;
+	double sectorRadius = bounds.sectorRadius + sectorReach;
+	if (!sphereInFrustum(frustum, x, bounds.middleHeight, z, sectorRadius)) return;
+	if (tooSmallToSee(frustum, x, bounds.middleHeight, z, sectorRadius, sectorReach, minPixels)) return;
+
+	for (int slab = 0; slab < ORBIT_INDEX_SLABS; slab++) {
+		int bin = firstBin + slab;
+		double y = bounds.slabY(slab);
+		double radius = bounds.slabRadius + binReach[bin];
+		if (binStart[bin] == binStart[bin + 1] || !sphereInFrustum(frustum, x, y, z, radius)) continue;
+		if (tooSmallToSee(frustum, x, y, z, radius, binReach[bin], minPixels)) continue;
+
+		findVisibleInBin(index, gasClouds, frustum, time, minPixels, binStart[bin], binStart[bin + 1] - binStart[bin],
+			visible, positions);
+	}
+}
+
+void findVisibleGasClouds(const GasIndex& index, const std::vector<GasCloud>& gasClouds,
+	const ViewFrustum& frustum, double time, float minPixels, std::vector<uint32_t>& visible,
+	std::vector<float>& positions) {
+	visible.clear();
+	positions.resize(gasClouds.size() * 2);
+
+	size_t numSlots = orbitIndexSlots(index.annuli.size());
+	std::vector<std::vector<uint32_t>> slotVisible(numSlots);
+
+	forEachSector(index.annuli.size(), [&](size_t a, int sector, size_t slot) {
+		findVisibleInSector(index, gasClouds, frustum, time, minPixels, a, sector, slotVisible[slot], positions);
+		});
+
+	for (size_t slot = 0; slot < numSlots; slot++) {
+		visible.insert(visible.end(), slotVisible[slot].begin(), slotVisible[slot].end());
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "GalacticGas.h"
+#include "OrbitIndex.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct ViewFrustum;
+
+// Gas clouds binned by orbital radius, angle and height so whole bins can be culled against the view.
+//
+// The turning annuli, sectors and slabs are OrbitIndex's, as for the stars: disk and halo
+// (coronal) clouds apart, each cut into annuli of equal cloud counts by orbital radius.
+//
+// A cloud is bounded by a sphere of gasCloudReach round its centre, each bin keeps the largest
+// of its clouds' so bins too small to see can go as a whole.
+
+const int GAS_INDEX_DISK_ANNULI = 32;
+const int GAS_INDEX_HALO_ANNULI = 8;
+
+struct GasIndex {
+	std::vector<uint32_t> order;		// cloud indices by annulus, then bin
+	std::vector<uint32_t> binStart;		// bin b of annulus a starts at order[binStart[a * ORBIT_INDEX_BINS + b]]
+	std::vector<float> binReach;		// the largest gasCloudReach in each bin
+	std::vector<OrbitAnnulus> annuli;	// disk annuli first, then halo
+
+	// what it indexes, anything different rebuilds it
+	const GasCloud* clouds = nullptr;
+	size_t count = 0;
+	unsigned long long generation = 0;
+};
+
+// Brings the index up to date with the clouds: rebuilt if they changed (generation is bumped
+// whenever they are), otherwise only the annuli that drifted too far at `time` are binned again
+void updateGasIndex(GasIndex& index, const std::vector<GasCloud>& gasClouds, unsigned long long generation,
+	double time);
+
+// The clouds that may be in view at `time` and would be at least minPixels across, in order,
+// and positions[cloud * 2] the x and z of each of them there (positions is sized for every cloud,
+// the others are left as they were). None in view and that large are left out
+void findVisibleGasClouds(const GasIndex& index, const std::vector<GasCloud>& gasClouds,
+	const ViewFrustum& frustum, double time, float minPixels, std::vector<uint32_t>& visible,
+	std::vector<float>& positions);
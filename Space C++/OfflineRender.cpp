@@ -0,0 +1,187 @@
+#include "OfflineRender.h"
+#include "GalaxyBuilder.h"
+#include "SoftwareRenderer.h"
+#include "FrameWriter.h"
+#include "ThreadPool.h"
+#include "OrbitKernels.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// x y z pitch yaw zoom, from argv[i + 1] on
+static bool parseCamera(char** argv, int& i, Camera& camera) {
+	camera.posX = atof(argv[++i]);
+	camera.posY = atof(argv[++i]);
+	camera.posZ = atof(argv[++i]);
+	camera.pitch = atof(argv[++i]);
+	camera.yaw = atof(argv[++i]);
+	camera.zoom = camera.zoomLevel = atof(argv[++i]);
+	return camera.zoom > 0.0;
+}
+
+// t from 0 at the first frame to 1 at the last
+static Camera cameraAlongPath(const OfflineRenderOptions& options, double t) {
+	if (!options.hasCameraEnd) return options.camera;
+
+	const Camera& from = options.camera;
+	const Camera& to = options.cameraEnd;
+	Camera camera = from;
+	camera.posX = from.posX + (to.posX - from.posX) * t;
+	camera.posY = from.posY + (to.posY - from.posY) * t;
+	camera.posZ = from.posZ + (to.posZ - from.posZ) * t;
+	camera.pitch = from.pitch + (to.pitch - from.pitch) * t;
+	camera.yaw = from.yaw + (to.yaw - from.yaw) * t;
+	camera.zoom = camera.zoomLevel = from.zoom * std::pow(to.zoom / from.zoom, t);
+	return camera;
+}
+
+bool wantsOfflineRender(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--render") == 0) return true;
+	}
+	return false;
+}
+
+bool parseOfflineRenderOptions(int argc, char** argv, OfflineRenderOptions& options) {
+	// above the disk looking down at it, the whole galaxy in view
+	options.camera.posX = 0.0;
+	options.camera.posY = 1500.0;
+	options.camera.posZ = 2000.0;
+	options.camera.pitch = -0.6;
+	options.camera.yaw = 0.0;
+	options.camera.zoom = options.camera.zoomLevel = 1.0;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		int remaining = argc - i - 1;
+		bool valid = true;
+
+		if (strcmp(arg, "--render") == 0 && remaining >= 1) {
+			options.output = argv[++i];
+		}
+		else if (strcmp(arg, "--size") == 0 && remaining >= 1) {
+			valid = sscanf(argv[++i], "%dx%d", &options.width, &options.height) == 2 &&
+				options.width > 0 && options.height > 0;
+		}
+		else if (strcmp(arg, "--time") == 0 && remaining >= 1) {
+			options.time = atof(argv[++i]);
+		}
+		else if (strcmp(arg, "--seed") == 0 && remaining >= 1) {
+			options.seed = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			options.hasSeed = true;
+		}
+		else if (strcmp(arg, "--stars") == 0 && remaining >= 1) {
+			options.numStars = atoi(argv[++i]);
+			valid = options.numStars > 0;
+		}
+		else if (strcmp(arg, "--threads") == 0 && remaining >= 1) {
+			options.numThreads = atoi(argv[++i]);
+			valid = options.numThreads >= 0;
+		}
+		else if (strcmp(arg, "--camera") == 0 && remaining >= 6) {
+			valid = parseCamera(argv, i, options.camera);
+		}
+		else if (strcmp(arg, "--camera-end") == 0 && remaining >= 6) {
+			valid = parseCamera(argv, i, options.cameraEnd);
+			options.hasCameraEnd = true;
+		}
+		else if (strcmp(arg, "--frames") == 0 && remaining >= 1) {
+			options.numFrames = atoi(argv[++i]);
+			valid = options.numFrames > 0;
+		}
+		else if (strcmp(arg, "--fps") == 0 && remaining >= 1) {
+			options.framesPerSecond = atof(argv[++i]);
+			valid = options.framesPerSecond > 0.0;
+		}
+		else if (strcmp(arg, "--time-speed") == 0 && remaining >= 1) {
+			options.timeSpeed = atof(argv[++i]);
+		}
+		else if (strcmp(arg, "--encoders") == 0 && remaining >= 1) {
+			options.numEncoders = atoi(argv[++i]);
+			valid = options.numEncoders >= 0;
+		}
+		else {
+			std::cerr << "Unknown or incomplete option " << arg << std::endl;
+			return false;
+		}
+
+		if (!valid) {
+			std::cerr << "Invalid value for " << arg << std::endl;
+			return false;
+		}
+	}
+
+	if (options.output.empty()) {
+		std::cerr << "--render needs an output file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int runOfflineRender(const OfflineRenderOptions& options, GalaxyConfig galaxyConfig,
+	const GasConfig& gasConfig, const BlackHoleConfig& blackHoleConfig) {
+	if (options.hasSeed) galaxyConfig.seed = options.seed;
+	if (options.numStars > 0) galaxyConfig.numStars = options.numStars;
+	galaxyConfig.numThreads = options.numThreads;
+	std::cout << "Galaxy seed: " << galaxyConfig.seed << std::endl;
+
+	startThreadPool(g_threadPool, options.numThreads);
+	std::cout << "Orbit kernel: " << orbitKernelName(activeOrbitKernel()) << std::endl;
+
+	GalaxyScene scene;
+	buildGalaxy(galaxyConfig, gasConfig, blackHoleConfig, scene);
+
+	FrameWriter writer;
+	startFrameWriter(writer, options.numEncoders);
+
+	// the writer's threads encode frame n while frame n + 1 renders; waiting is the time
+	// spent on a full queue, which is what the disk adds to the run
+	SoftwareFrame frame;
+	std::vector<uint8_t> rgb;
+	double renderTime = 0.0, waitTime = 0.0;
+	auto runStart = std::chrono::steady_clock::now();
+
+	for (int n = 0; n < options.numFrames; n++) {
+		double time = options.time + n * options.timeSpeed / options.framesPerSecond;
+		double along = options.numFrames > 1 ? n / static_cast<double>(options.numFrames - 1) : 0.0;
+
+		auto start = std::chrono::steady_clock::now();
+		renderSoftwareFrame(frame, options.width, options.height, scene.stars, scene.gasClouds,
+			scene.blackHoles, time, cameraAlongPath(options, along));
+		softwareFrameToRGB8(frame, rgb);
+		renderTime += millisecondsSince(start);
+
+		std::string path = options.numFrames > 1 ? frameFileName(options.output, n) : options.output;
+		start = std::chrono::steady_clock::now();
+		queueFrame(writer, path, rgb, frame.width, frame.height);
+		waitTime += millisecondsSince(start);
+	}
+
+	auto flushStart = std::chrono::steady_clock::now();
+	int numEncoders = frameWriterSize(writer);
+	stopFrameWriter(writer);
+	double flushTime = millisecondsSince(flushStart);
+	double totalTime = millisecondsSince(runStart);
+
+	int numThreads = threadPoolSize(g_threadPool);
+	stopThreadPool(g_threadPool);
+
+	std::cout << "Rendered " << options.numFrames << " frame(s) of " << options.width << "x" << options.height <<
+		" on " << numThreads << " threads in " << totalTime << " ms: " <<
+		renderTime / options.numFrames << " ms per frame rendering, " <<
+		writer.encodeMilliseconds / options.numFrames << " ms per frame encoding on " << numEncoders <<
+		" threads, " << waitTime + flushTime << " ms waiting for them" << std::endl;
+
+	if (writer.framesFailed > 0) {
+		std::cerr << writer.framesFailed << " frame(s) could not be written" << std::endl;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "Camera.h"
+#include "Stars.h"
+#include "GalacticGas.h"
+#include "BlackHole.h"
+#include <string>
+
+// Renders straight to image files with the software renderer, so frames can be made on
+// machines without a GPU or a display. Nothing on this path touches GLFW or GL.
+//
+//   --render frame.png               render to this file and exit; for a sequence a name
+//                                    like frame_%05d.png, or _%05d is added before the extension
+//   --size 1920x1080
+//   --time seconds                   simulation time of the (first) frame
+//   --seed n, --stars n              the galaxy, otherwise a random seed and the default count
+//   --camera x y z pitch yaw zoom    otherwise an overview of the whole galaxy
+//   --threads n                      render threads, 0 for one per core
+//
+// Sequences step the simulation by a fixed time per frame and write the frames on their own
+// threads while the next ones render:
+//
+//   --frames n                       1 by default
+//   --fps n                          60 by default
+//   --time-speed x                   simulation seconds per second of video, 1 by default
+//   --camera-end x y z pitch yaw zoom    fly in a straight line from --camera to here,
+//                                    zoom changes by the same factor every frame
+//   --encoders n                     PNG encoding threads, 0 for a quarter of the cores
+
+struct OfflineRenderOptions {
+	std::string output;
+	int width = 1920, height = 1080;
+	double time = 0.0;
+	bool hasSeed = false;
+	unsigned int seed = 0;
+	int numStars = 0;		// 0 keeps the config's
+	int numThreads = 0;
+	Camera camera;
+
+	int numFrames = 1;
+	double framesPerSecond = 60.0;
+	double timeSpeed = 1.0;
+	bool hasCameraEnd = false;
+	Camera cameraEnd;
+	int numEncoders = 0;
+};
+
+// true if the command line asks for an offline render instead of the window
+bool wantsOfflineRender(int argc, char** argv);
+// false, after printing why, if an argument is unknown or malformed
+bool parseOfflineRenderOptions(int argc, char** argv, OfflineRenderOptions& options);
+// builds the galaxy and writes the frames, returns the exit code
+int runOfflineRender(const OfflineRenderOptions& options, GalaxyConfig galaxyConfig,
+	const GasConfig& gasConfig, const BlackHoleConfig& blackHoleConfig);
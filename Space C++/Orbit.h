@@ -0,0 +1,15 @@
+#pragma once
+#include <cmath>
+
+// Everything in the galaxy moves on circular orbits (or just spins), so its state at any
+// simulation time follows from the angle at time 0. Nothing is integrated per frame,
+// which keeps far-off times exact and lets the time speed go as high as it likes.
+
+// angle at `time`, wrapped to [0, 2*PI). The product is formed and wrapped in double,
+// so float precision only applies to the wrapped result however large time gets
+inline float rotationAngleAt(float initialAngle, float angularVelocity, double time) {
+	const double TWO_PI = 6.283185307179586;
+	double angle = initialAngle + angularVelocity * time;
+	angle -= std::floor(angle * (1.0 / TWO_PI)) * TWO_PI;
+	return static_cast<float>(angle);
+}
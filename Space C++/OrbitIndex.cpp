@@ -0,0 +1,86 @@
+#include "OrbitIndex.h"
+#include "Camera.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+const double TWO_PI = 6.283185307179586;
+const double SECTOR_WIDTH = TWO_PI / ORBIT_INDEX_SECTORS;
+
+// the same slack in angle
+const double ORBIT_INDEX_ANGLE_MARGIN = 0.01;
+
+double annulusTurns(const OrbitAnnulus& annulus, double angle, double angularVelocity, double time) {
+	double turns = (angle + (angularVelocity - annulus.meanAngularVelocity) * time) * (1.0 / TWO_PI);
+	return turns - std::floor(turns);
+}
+
+int annulusBin(const OrbitAnnulus& annulus, double turns, float height) {
+	int sector = std::min(static_cast<int>(turns * ORBIT_INDEX_SECTORS), ORBIT_INDEX_SECTORS - 1);
+
+	int slab = 0;
+	float range = annulus.maxHeight - annulus.minHeight;
+	if (range > 0.0f) {
+		slab = static_cast<int>((height - annulus.minHeight) / range * ORBIT_INDEX_SLABS);
+		slab = std::min(std::max(slab, 0), ORBIT_INDEX_SLABS - 1);
+	}
+	return sector * ORBIT_INDEX_SLABS + slab;
+}
+
+double annulusDrift(const OrbitAnnulus& annulus, double time) {
+	return annulus.maxDrift * std::abs(time - annulus.binnedTime);
+}
+
+bool annulusDrifted(const OrbitAnnulus& annulus, double time) {
+	return annulus.count > 0 && annulusDrift(annulus, time) > SECTOR_WIDTH * 0.5;
+}
+
+// Radius of a sphere round the middle of a ring segment that holds all of it: the farthest
+// points are on the segment's ends, at the inner or outer radius
+static double segmentBoundingRadius(double innerRadius, double outerRadius, double halfAngle, double halfHeight) {
+	double middle = (innerRadius + outerRadius) * 0.5;
+	double cosine = std::cos(std::min(halfAngle, M_PI));
+	double inner = innerRadius * innerRadius + middle * middle - 2.0 * innerRadius * middle * cosine;
+	double outer = outerRadius * outerRadius + middle * middle - 2.0 * outerRadius * middle * cosine;
+	return std::sqrt(std::max(inner, outer) + halfHeight * halfHeight) + ORBIT_INDEX_DISTANCE_MARGIN;
+}
+
+bool annulusInFrustum(const OrbitAnnulus& annulus, const ViewFrustum& frustum, double reach) {
+	double middleHeight = (annulus.minHeight + annulus.maxHeight) * 0.5;
+	double halfHeight = (annulus.maxHeight - annulus.minHeight) * 0.5;
+	return sphereInFrustum(frustum, 0.0, middleHeight, 0.0,
+		std::sqrt(annulus.outerRadius * annulus.outerRadius + halfHeight * halfHeight) + reach +
+		ORBIT_INDEX_DISTANCE_MARGIN);
+}
+
+void sectorBounds(const OrbitAnnulus& annulus, int sector, double time, SectorBounds& bounds) {
+	double pad = annulusDrift(annulus, time) + ORBIT_INDEX_ANGLE_MARGIN;
+	double rotation = std::fmod(annulus.meanAngularVelocity * time, TWO_PI);
+	double middleRadius = (annulus.innerRadius + annulus.outerRadius) * 0.5;
+	double halfAngle = SECTOR_WIDTH * 0.5 + pad;
+	double halfHeight = (annulus.maxHeight - annulus.minHeight) * 0.5;
+
+	double middleAngle = rotation + (sector + 0.5) * SECTOR_WIDTH;
+	bounds.x = middleRadius * std::cos(middleAngle);
+	bounds.z = middleRadius * std::sin(middleAngle);
+	bounds.middleHeight = (annulus.minHeight + annulus.maxHeight) * 0.5;
+	bounds.sectorRadius = segmentBoundingRadius(annulus.innerRadius, annulus.outerRadius, halfAngle, halfHeight);
+
+	bounds.minHeight = annulus.minHeight;
+	bounds.slabHeight = (annulus.maxHeight - annulus.minHeight) / ORBIT_INDEX_SLABS;
+	bounds.slabRadius = segmentBoundingRadius(annulus.innerRadius, annulus.outerRadius, halfAngle,
+		bounds.slabHeight * 0.5);
+}
+
+size_t orbitIndexSlots(size_t numAnnuli) {
+	return (numAnnuli * ORBIT_INDEX_SECTORS + PARALLEL_FOR_ALIGNMENT - 1) / PARALLEL_FOR_ALIGNMENT;
+}
+
+void forEachSector(size_t numAnnuli, const SectorVisit& visit) {
+	parallelFor(g_threadPool, numAnnuli * ORBIT_INDEX_SECTORS, 1, [&](size_t begin, size_t end) {
+		size_t slot = begin / PARALLEL_FOR_ALIGNMENT;
+		for (size_t i = begin; i < end; i++) {
+			visit(i / ORBIT_INDEX_SECTORS, static_cast<int>(i % ORBIT_INDEX_SECTORS), slot);
+		}
+		});
+}
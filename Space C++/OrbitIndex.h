@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+struct ViewFrustum;
+
+// The geometry shared by the star and gas indexes: bodies on circular orbits binned by radius,
+// angle and height so whole bins can be culled against the view.
+//
+// Bodies of similar orbital radius form an annulus. An annulus turns as a unit at the mean
+// angular velocity of its bodies and is cut into sectors that turn with it, and each sector
+// into height slabs. A body moves through its annulus at its own velocity minus the mean, so
+// the sectors' bounds are widened by how far the fastest of them can have drifted since it
+// was binned; once that passes half a sector the annulus is binned again.
+
+const int ORBIT_INDEX_SECTORS = 32;
+const int ORBIT_INDEX_SLABS = 4;
+// sector-major, sector * ORBIT_INDEX_SLABS + slab
+const int ORBIT_INDEX_BINS = ORBIT_INDEX_SECTORS * ORBIT_INDEX_SLABS;
+// slack on the bounds for rounding: the bodies are turned in float, by the shaders and the
+// orbit kernels, which can be a little off the double angles here
+const double ORBIT_INDEX_DISTANCE_MARGIN = 0.01;
+
+struct OrbitAnnulus {
+	float innerRadius, outerRadius;		// of its bodies' orbits
+	float minHeight, maxHeight;			// the slabs split this evenly
+	double meanAngularVelocity;
+	double maxDrift;					// largest |angularVelocity - mean| of its bodies
+	double binnedTime;					// sectors hold the bodies' angles relative to the annulus then
+	uint32_t first, count;				// its bodies' span of the index order
+};
+
+// where a body is relative to the turning annulus at `time`, in turns from 0 up to 1
+double annulusTurns(const OrbitAnnulus& annulus, double angle, double angularVelocity, double time);
+// the bin of a body that far round and that high
+int annulusBin(const OrbitAnnulus& annulus, double turns, float height);
+
+// how far the annulus' bodies may have moved from their sectors by `time`, in radians
+double annulusDrift(const OrbitAnnulus& annulus, double time);
+// true once that is far enough for the annulus to be binned again
+bool annulusDrifted(const OrbitAnnulus& annulus, double time);
+
+// Spheres holding one sector of an annulus at `time`, drift included, and each of its slabs
+struct SectorBounds {
+	double x, z;				// the sector's middle
+	double middleHeight;
+	double sectorRadius;
+	double slabRadius;
+	double slabHeight;			// slab s is centred at slabY(s)
+	double minHeight;
+
+	double slabY(int slab) const { return minHeight + (slab + 0.5) * slabHeight; }
+};
+
+// false if the whole annulus, reach further all round, is out of view
+bool annulusInFrustum(const OrbitAnnulus& annulus, const ViewFrustum& frustum, double reach);
+void sectorBounds(const OrbitAnnulus& annulus, int sector, double time, SectorBounds& bounds);
+
+// Calls visit for every sector of numAnnuli annuli, shared out over the thread pool. The
+// ranges parallelFor hands out start on multiples of PARALLEL_FOR_ALIGNMENT, so each sector
+// is given the slot of its range's start: results kept per slot and joined up slot by slot
+// come out in sector order
+using SectorVisit = std::function<void(size_t annulus, int sector, size_t slot)>;
+size_t orbitIndexSlots(size_t numAnnuli);
+void forEachSector(size_t numAnnuli, const SectorVisit& visit);
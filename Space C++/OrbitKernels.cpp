@@ -0,0 +1,354 @@
+#include "OrbitKernels.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ORBIT_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic anywhere, gcc and clang need the ISA enabled per function.
+// avx512f brings FMA with it, and gcc would fuse the kernel's mul+add pairs into it, so the
+// AVX-512 lanes would no longer match the others bit for bit; contraction is kept off
+#if defined(ORBIT_KERNELS_X86) && defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#define ORBIT_TARGET(isa) __attribute__((target(isa)))
+#elif defined(ORBIT_KERNELS_X86) && !defined(_MSC_VER)
+#define ORBIT_TARGET(isa) __attribute__((target(isa), optimize("fp-contract=off")))
+#else
+#define ORBIT_TARGET(isa)
+#endif
+
+// phase wrapping, in double
+static const double INV_TWO_PI = 0.15915494309189535;
+static const double TWO_PI_HI = 6.283185307179586;
+static const double TWO_PI_LO = 2.4492935982947064e-16;
+static const double ROUND_MAGIC_D = 6755399441055744.0;	// 1.5 * 2^52, adding it rounds to an integer
+
+// quadrant reduction, in float. PI/2 is split so q * PIO2_1 and q * PIO2_2 are exact
+static const float TWO_OVER_PI = 0.636619772f;
+static const float PIO2_1 = 1.5703125f;
+static const float PIO2_2 = 4.837512969970703125e-4f;
+static const float PIO2_3 = 7.54978995489188216e-8f;
+static const float ROUND_MAGIC_F = 12582912.0f;		// 1.5 * 2^23, the low mantissa bits then hold the quadrant
+
+// minimax polynomials on [-PI/4, PI/4] (cephes sinf/cosf)
+static const float SIN_1 = -1.6666654611e-1f;
+static const float SIN_2 = 8.3321608736e-3f;
+static const float SIN_3 = -1.9515295891e-4f;
+static const float COS_1 = 4.166664568298827e-2f;
+static const float COS_2 = -1.388731625493765e-3f;
+static const float COS_3 = 2.443315711809948e-5f;
+
+static uint32_t floatBits(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static float bitsFloat(uint32_t bits) {
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+// angle + w*t wrapped to [-PI, PI]. Good while the phase stays under 2^51 radians
+static float wrapPhase(float angle, float angularVelocity, double time) {
+	double phase = static_cast<double>(angle) + static_cast<double>(angularVelocity) * time;
+	double n = (phase * INV_TWO_PI + ROUND_MAGIC_D) - ROUND_MAGIC_D;
+	return static_cast<float>((phase - n * TWO_PI_HI) - n * TWO_PI_LO);
+}
+
+void orbitSinCos(float angle, float& s, float& c) {
+	float qf = angle * TWO_OVER_PI + ROUND_MAGIC_F;
+	uint32_t quadrant = floatBits(qf);
+	qf -= ROUND_MAGIC_F;
+
+	float y = ((angle - qf * PIO2_1) - qf * PIO2_2) - qf * PIO2_3;
+	float zz = y * y;
+	float sinPoly = ((SIN_3 * zz + SIN_2) * zz + SIN_1) * zz * y + y;
+	float cosPoly = ((COS_3 * zz + COS_2) * zz + COS_1) * zz * zz - 0.5f * zz + 1.0f;
+
+	bool swap = (quadrant & 1) != 0;
+	s = bitsFloat(floatBits(swap ? cosPoly : sinPoly) ^ ((quadrant & 2) << 30));
+	c = bitsFloat(floatBits(swap ? sinPoly : cosPoly) ^ (((quadrant + 1) & 2) << 30));
+}
+
+static void orbitXZScalar(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z) {
+	for (size_t i = 0; i < count; i++) {
+		float s, c;
+		orbitSinCos(wrapPhase(angle[i], angularVelocity[i], time), s, c);
+		x[i] = radius[i] * c;
+		z[i] = radius[i] * s;
+	}
+}
+
+#ifdef ORBIT_KERNELS_X86
+
+// The vector kernels below are the scalar one lane by lane, in the same operation order.
+
+ORBIT_TARGET("sse2")
+static __m128d wrapPhaseSse2(__m128d angle, __m128d angularVelocity, __m128d time) {
+	__m128d phase = _mm_add_pd(angle, _mm_mul_pd(angularVelocity, time));
+	__m128d n = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(phase, _mm_set1_pd(INV_TWO_PI)), _mm_set1_pd(ROUND_MAGIC_D)),
+		_mm_set1_pd(ROUND_MAGIC_D));
+	return _mm_sub_pd(_mm_sub_pd(phase, _mm_mul_pd(n, _mm_set1_pd(TWO_PI_HI))), _mm_mul_pd(n, _mm_set1_pd(TWO_PI_LO)));
+}
+
+ORBIT_TARGET("sse2")
+static void orbitXZSse2(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z) {
+	const __m128d t = _mm_set1_pd(time);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 a = _mm_loadu_ps(angle + i);
+		__m128 w = _mm_loadu_ps(angularVelocity + i);
+		__m128d phaseLo = wrapPhaseSse2(_mm_cvtps_pd(a), _mm_cvtps_pd(w), t);
+		__m128d phaseHi = wrapPhaseSse2(_mm_cvtps_pd(_mm_movehl_ps(a, a)), _mm_cvtps_pd(_mm_movehl_ps(w, w)), t);
+		__m128 phase = _mm_movelh_ps(_mm_cvtpd_ps(phaseLo), _mm_cvtpd_ps(phaseHi));
+
+		__m128 qf = _mm_add_ps(_mm_mul_ps(phase, _mm_set1_ps(TWO_OVER_PI)), _mm_set1_ps(ROUND_MAGIC_F));
+		__m128i quadrant = _mm_castps_si128(qf);
+		qf = _mm_sub_ps(qf, _mm_set1_ps(ROUND_MAGIC_F));
+
+		__m128 y = _mm_sub_ps(phase, _mm_mul_ps(qf, _mm_set1_ps(PIO2_1)));
+		y = _mm_sub_ps(y, _mm_mul_ps(qf, _mm_set1_ps(PIO2_2)));
+		y = _mm_sub_ps(y, _mm_mul_ps(qf, _mm_set1_ps(PIO2_3)));
+		__m128 zz = _mm_mul_ps(y, y);
+
+		__m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_3), zz), _mm_set1_ps(SIN_2));
+		sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, zz), _mm_set1_ps(SIN_1));
+		sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, zz), y), y);
+
+		__m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_3), zz), _mm_set1_ps(COS_2));
+		cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, zz), _mm_set1_ps(COS_1));
+		cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, zz), zz);
+		cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(_mm_set1_ps(0.5f), zz)), _mm_set1_ps(1.0f));
+
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+		__m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+		__m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+		s = _mm_xor_ps(s, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30)));
+		c = _mm_xor_ps(c, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30)));
+
+		__m128 r = _mm_loadu_ps(radius + i);
+		_mm_storeu_ps(x + i, _mm_mul_ps(r, c));
+		_mm_storeu_ps(z + i, _mm_mul_ps(r, s));
+	}
+
+	orbitXZScalar(radius + i, angle + i, angularVelocity + i, count - i, time, x + i, z + i);
+}
+
+ORBIT_TARGET("avx2")
+static __m256d wrapPhaseAvx2(__m256d angle, __m256d angularVelocity, __m256d time) {
+	__m256d phase = _mm256_add_pd(angle, _mm256_mul_pd(angularVelocity, time));
+	__m256d n = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(phase, _mm256_set1_pd(INV_TWO_PI)),
+		_mm256_set1_pd(ROUND_MAGIC_D)), _mm256_set1_pd(ROUND_MAGIC_D));
+	return _mm256_sub_pd(_mm256_sub_pd(phase, _mm256_mul_pd(n, _mm256_set1_pd(TWO_PI_HI))),
+		_mm256_mul_pd(n, _mm256_set1_pd(TWO_PI_LO)));
+}
+
+ORBIT_TARGET("avx2")
+static void orbitXZAvx2(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z) {
+	const __m256d t = _mm256_set1_pd(time);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i two = _mm256_set1_epi32(2);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256d phaseLo = wrapPhaseAvx2(_mm256_cvtps_pd(_mm_loadu_ps(angle + i)),
+			_mm256_cvtps_pd(_mm_loadu_ps(angularVelocity + i)), t);
+		__m256d phaseHi = wrapPhaseAvx2(_mm256_cvtps_pd(_mm_loadu_ps(angle + i + 4)),
+			_mm256_cvtps_pd(_mm_loadu_ps(angularVelocity + i + 4)), t);
+		__m256 phase = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(phaseLo)), _mm256_cvtpd_ps(phaseHi), 1);
+
+		__m256 qf = _mm256_add_ps(_mm256_mul_ps(phase, _mm256_set1_ps(TWO_OVER_PI)), _mm256_set1_ps(ROUND_MAGIC_F));
+		__m256i quadrant = _mm256_castps_si256(qf);
+		qf = _mm256_sub_ps(qf, _mm256_set1_ps(ROUND_MAGIC_F));
+
+		__m256 y = _mm256_sub_ps(phase, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_1)));
+		y = _mm256_sub_ps(y, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_2)));
+		y = _mm256_sub_ps(y, _mm256_mul_ps(qf, _mm256_set1_ps(PIO2_3)));
+		__m256 zz = _mm256_mul_ps(y, y);
+
+		__m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_3), zz), _mm256_set1_ps(SIN_2));
+		sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, zz), _mm256_set1_ps(SIN_1));
+		sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, zz), y), y);
+
+		__m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_3), zz), _mm256_set1_ps(COS_2));
+		cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, zz), _mm256_set1_ps(COS_1));
+		cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, zz), zz);
+		cosPoly = _mm256_add_ps(_mm256_sub_ps(cosPoly, _mm256_mul_ps(_mm256_set1_ps(0.5f), zz)), _mm256_set1_ps(1.0f));
+
+		__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+		__m256 s = _mm256_blendv_ps(sinPoly, cosPoly, swap);
+		__m256 c = _mm256_blendv_ps(cosPoly, sinPoly, swap);
+		s = _mm256_xor_ps(s, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30)));
+		c = _mm256_xor_ps(c, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30)));
+
+		__m256 r = _mm256_loadu_ps(radius + i);
+		_mm256_storeu_ps(x + i, _mm256_mul_ps(r, c));
+		_mm256_storeu_ps(z + i, _mm256_mul_ps(r, s));
+	}
+
+	orbitXZScalar(radius + i, angle + i, angularVelocity + i, count - i, time, x + i, z + i);
+}
+
+ORBIT_TARGET("avx512f")
+static __m512d wrapPhaseAvx512(__m512d angle, __m512d angularVelocity, __m512d time) {
+	__m512d phase = _mm512_add_pd(angle, _mm512_mul_pd(angularVelocity, time));
+	__m512d n = _mm512_sub_pd(_mm512_add_pd(_mm512_mul_pd(phase, _mm512_set1_pd(INV_TWO_PI)),
+		_mm512_set1_pd(ROUND_MAGIC_D)), _mm512_set1_pd(ROUND_MAGIC_D));
+	return _mm512_sub_pd(_mm512_sub_pd(phase, _mm512_mul_pd(n, _mm512_set1_pd(TWO_PI_HI))),
+		_mm512_mul_pd(n, _mm512_set1_pd(TWO_PI_LO)));
+}
+
+ORBIT_TARGET("avx512f")
+static void orbitXZAvx512(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z) {
+	const __m512d t = _mm512_set1_pd(time);
+	const __m512i one = _mm512_set1_epi32(1);
+	const __m512i two = _mm512_set1_epi32(2);
+
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m512d phaseLo = wrapPhaseAvx512(_mm512_cvtps_pd(_mm256_loadu_ps(angle + i)),
+			_mm512_cvtps_pd(_mm256_loadu_ps(angularVelocity + i)), t);
+		__m512d phaseHi = wrapPhaseAvx512(_mm512_cvtps_pd(_mm256_loadu_ps(angle + i + 8)),
+			_mm512_cvtps_pd(_mm256_loadu_ps(angularVelocity + i + 8)), t);
+		// two 8-float halves into one register, without needing AVX-512DQ
+		__m512 phase = _mm512_castpd_ps(_mm512_insertf64x4(
+			_mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(phaseLo))),
+			_mm256_castps_pd(_mm512_cvtpd_ps(phaseHi)), 1));
+
+		__m512 qf = _mm512_add_ps(_mm512_mul_ps(phase, _mm512_set1_ps(TWO_OVER_PI)), _mm512_set1_ps(ROUND_MAGIC_F));
+		__m512i quadrant = _mm512_castps_si512(qf);
+		qf = _mm512_sub_ps(qf, _mm512_set1_ps(ROUND_MAGIC_F));
+
+		__m512 y = _mm512_sub_ps(phase, _mm512_mul_ps(qf, _mm512_set1_ps(PIO2_1)));
+		y = _mm512_sub_ps(y, _mm512_mul_ps(qf, _mm512_set1_ps(PIO2_2)));
+		y = _mm512_sub_ps(y, _mm512_mul_ps(qf, _mm512_set1_ps(PIO2_3)));
+		__m512 zz = _mm512_mul_ps(y, y);
+
+		__m512 sinPoly = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(SIN_3), zz), _mm512_set1_ps(SIN_2));
+		sinPoly = _mm512_add_ps(_mm512_mul_ps(sinPoly, zz), _mm512_set1_ps(SIN_1));
+		sinPoly = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(sinPoly, zz), y), y);
+
+		__m512 cosPoly = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(COS_3), zz), _mm512_set1_ps(COS_2));
+		cosPoly = _mm512_add_ps(_mm512_mul_ps(cosPoly, zz), _mm512_set1_ps(COS_1));
+		cosPoly = _mm512_mul_ps(_mm512_mul_ps(cosPoly, zz), zz);
+		cosPoly = _mm512_add_ps(_mm512_sub_ps(cosPoly, _mm512_mul_ps(_mm512_set1_ps(0.5f), zz)), _mm512_set1_ps(1.0f));
+
+		__mmask16 swap = _mm512_test_epi32_mask(quadrant, one);
+		__m512i s = _mm512_castps_si512(_mm512_mask_blend_ps(swap, sinPoly, cosPoly));
+		__m512i c = _mm512_castps_si512(_mm512_mask_blend_ps(swap, cosPoly, sinPoly));
+		s = _mm512_xor_si512(s, _mm512_slli_epi32(_mm512_and_si512(quadrant, two), 30));
+		c = _mm512_xor_si512(c, _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(quadrant, one), two), 30));
+
+		__m512 r = _mm512_loadu_ps(radius + i);
+		_mm512_storeu_ps(x + i, _mm512_mul_ps(r, _mm512_castsi512_ps(c)));
+		_mm512_storeu_ps(z + i, _mm512_mul_ps(r, _mm512_castsi512_ps(s)));
+	}
+
+	orbitXZScalar(radius + i, angle + i, angularVelocity + i, count - i, time, x + i, z + i);
+}
+
+static void cpuid(int info[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+	__cpuidex(info, leaf, subleaf);
+#else
+	__cpuid_count(leaf, subleaf, info[0], info[1], info[2], info[3]);
+#endif
+}
+
+// which register states the OS saves on a context switch
+static uint64_t enabledRegisterStates() {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static OrbitKernel detectOrbitKernel() {
+	int info[4];
+	cpuid(info, 0, 0);
+	const int maxLeaf = info[0];
+
+	cpuid(info, 1, 0);
+	const bool sse2 = (info[3] & (1 << 26)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!sse2) return ORBIT_KERNEL_SCALAR;
+	if (!osxsave || !avx) return ORBIT_KERNEL_SSE2;
+
+	const uint64_t states = enabledRegisterStates();
+	const bool ymmSaved = (states & 0x6) == 0x6;
+	const bool zmmSaved = (states & 0xE6) == 0xE6;
+	if (!ymmSaved || maxLeaf < 7) return ORBIT_KERNEL_SSE2;
+
+	cpuid(info, 7, 0);
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	const bool avx512f = (info[1] & (1 << 16)) != 0;
+
+	if (avx512f && zmmSaved) return ORBIT_KERNEL_AVX512;
+	if (avx2) return ORBIT_KERNEL_AVX2;
+	return ORBIT_KERNEL_SSE2;
+}
+
+#else
+
+static OrbitKernel detectOrbitKernel() {
+	return ORBIT_KERNEL_SCALAR;
+}
+
+#endif
+
+static OrbitKernel supportedOrbitKernel() {
+	static const OrbitKernel best = detectOrbitKernel();
+	return best;
+}
+
+static OrbitKernel g_orbitKernel = supportedOrbitKernel();
+
+OrbitKernel activeOrbitKernel() {
+	return g_orbitKernel;
+}
+
+void setOrbitKernel(OrbitKernel kernel) {
+	g_orbitKernel = (kernel <= supportedOrbitKernel()) ? kernel : supportedOrbitKernel();
+}
+
+const char* orbitKernelName(OrbitKernel kernel) {
+	switch (kernel) {
+	case ORBIT_KERNEL_SCALAR: return "scalar";
+	case ORBIT_KERNEL_SSE2: return "SSE2";
+	case ORBIT_KERNEL_AVX2: return "AVX2";
+	case ORBIT_KERNEL_AVX512: return "AVX-512";
+	}
+	return "unknown";
+}
+
+void computeOrbitXZ(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z) {
+	switch (g_orbitKernel) {
+#ifdef ORBIT_KERNELS_X86
+	case ORBIT_KERNEL_AVX512: orbitXZAvx512(radius, angle, angularVelocity, count, time, x, z); return;
+	case ORBIT_KERNEL_AVX2: orbitXZAvx2(radius, angle, angularVelocity, count, time, x, z); return;
+	case ORBIT_KERNEL_SSE2: orbitXZSse2(radius, angle, angularVelocity, count, time, x, z); return;
+#endif
+	default: orbitXZScalar(radius, angle, angularVelocity, count, time, x, z); return;
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+
+// Vectorised circular orbit evaluation for whole particle arrays.
+//
+// The phase angle + w*t is formed and wrapped in double lanes (branch-free round-to-nearest),
+// then a float polynomial sincos works on 4/8/16 lanes: Cody-Waite reduction to +-PI/4
+// and minimax polynomials, max abs error 8e-8 for angles up to +-8192. The wrapped phase
+// is rounded to float on the way in, so against the exact sin and cos of the double phase
+// the kernels are within 3e-7; the double phase itself stays within 1e-6 radians of
+// angle + w*t up to w*t of about 1e9. --self-test checks both bounds.
+// Every kernel does the same operations in the same order, the scalar one included, so they
+// agree bit for bit as long as the compiler doesn't fuse mul+add into FMA (MSVC doesn't,
+// gcc and clang are told not to).
+
+enum OrbitKernel {
+	ORBIT_KERNEL_SCALAR,
+	ORBIT_KERNEL_SSE2,
+	ORBIT_KERNEL_AVX2,
+	ORBIT_KERNEL_AVX512,
+};
+
+// the best kernel this CPU and OS support, picked on first use
+OrbitKernel activeOrbitKernel();
+// forces a kernel (for comparing them), falls back to the best supported one if it isn't
+void setOrbitKernel(OrbitKernel kernel);
+const char* orbitKernelName(OrbitKernel kernel);
+
+// x[i] = radius[i] * cos(angle[i] + angularVelocity[i] * time), z[i] the same with sin
+void computeOrbitXZ(const float* radius, const float* angle, const float* angularVelocity,
+	size_t count, double time, float* x, float* z);
+
+// the scalar kernel on its own, also what the vector kernels do per lane
+void orbitSinCos(float angle, float& s, float& c);
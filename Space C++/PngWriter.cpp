@@ -0,0 +1,289 @@
+#include "PngWriter.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+
+// deflate limits
+const int DEFLATE_WINDOW = 32768;
+const int DEFLATE_MIN_MATCH = 3;
+const int DEFLATE_MAX_MATCH = 258;
+
+// longer chains find longer matches but slow down on the flat black rows frames are full of
+const int MATCH_CHAIN_DEPTH = 8;
+const int MATCH_HASH_BITS = 15;
+
+static const uint16_t LENGTH_BASE[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// deflate packs bits from the least significant end
+struct BitWriter {
+	std::vector<uint8_t>& out;
+	uint32_t bits = 0;
+	int count = 0;
+
+	explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+	void write(uint32_t value, int numBits) {
+		bits |= value << count;
+		count += numBits;
+		while (count >= 8) {
+			out.push_back(static_cast<uint8_t>(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	// Huffman codes go most significant bit first
+	void writeCode(uint32_t code, int numBits) {
+		uint32_t reversed = 0;
+		for (int i = 0; i < numBits; i++) {
+			reversed = (reversed << 1) | ((code >> i) & 1);
+		}
+		write(reversed, numBits);
+	}
+
+	void flush() {
+		if (count > 0) out.push_back(static_cast<uint8_t>(bits));
+		bits = 0;
+		count = 0;
+	}
+};
+
+// symbol 0-287 of the fixed literal/length code
+static void writeLiteralLength(BitWriter& writer, int symbol) {
+	if (symbol < 144) writer.writeCode(0x30 + symbol, 8);
+	else if (symbol < 256) writer.writeCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280) writer.writeCode(symbol - 256, 7);
+	else writer.writeCode(0xC0 + symbol - 280, 8);
+}
+
+static void writeMatch(BitWriter& writer, int length, int distance) {
+	int lengthCode = 28;
+	while (LENGTH_BASE[lengthCode] > length) lengthCode--;
+	writeLiteralLength(writer, 257 + lengthCode);
+	writer.write(length - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode]);
+
+	int distanceCode = 29;
+	while (DISTANCE_BASE[distanceCode] > distance) distanceCode--;
+	writer.writeCode(distanceCode, 5);
+	writer.write(distance - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA[distanceCode]);
+}
+
+static uint32_t matchHash(const uint8_t* p) {
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 2654435761u) >> (32 - MATCH_HASH_BITS);
+}
+
+// one final block with the fixed codes
+static void deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out) {
+	BitWriter writer(out);
+	writer.write(1, 1);		// final block
+	writer.write(1, 2);		// fixed Huffman codes
+
+	const int size = static_cast<int>(data.size());
+	const uint8_t* bytes = data.data();
+
+	// the last position each hash was seen at and, per position, the one before it
+	std::vector<int> head(1 << MATCH_HASH_BITS, -1);
+	std::vector<int> previous(DEFLATE_WINDOW, -1);
+
+	auto insert = [&](int position) {
+		uint32_t hash = matchHash(bytes + position);
+		previous[position & (DEFLATE_WINDOW - 1)] = head[hash];
+		head[hash] = position;
+	};
+
+	int position = 0;
+	while (position < size) {
+		int bestLength = 0, bestDistance = 0;
+
+		if (position + DEFLATE_MIN_MATCH <= size) {
+			int maxLength = std::min(DEFLATE_MAX_MATCH, size - position);
+			int candidate = head[matchHash(bytes + position)];
+
+			for (int depth = 0; depth < MATCH_CHAIN_DEPTH && candidate >= 0; depth++) {
+				int distance = position - candidate;
+				if (distance > DEFLATE_WINDOW - 1) break;
+
+				int length = 0;
+				while (length < maxLength && bytes[candidate + length] == bytes[position + length]) length++;
+				if (length > bestLength) {
+					bestLength = length;
+					bestDistance = distance;
+					if (length == maxLength) break;
+				}
+				candidate = previous[candidate & (DEFLATE_WINDOW - 1)];
+			}
+		}
+
+		if (bestLength >= DEFLATE_MIN_MATCH) {
+			writeMatch(writer, bestLength, bestDistance);
+			int end = std::min(position + bestLength, size - DEFLATE_MIN_MATCH + 1);
+			for (int p = position; p < end; p++) insert(p);
+			position += bestLength;
+		}
+		else {
+			writeLiteralLength(writer, bytes[position]);
+			if (position + DEFLATE_MIN_MATCH <= size) insert(position);
+			position++;
+		}
+	}
+
+	writeLiteralLength(writer, 256);
+	writer.flush();
+}
+
+static uint32_t adler32(const std::vector<uint8_t>& data) {
+	uint32_t a = 1, b = 0;
+	size_t i = 0;
+	while (i < data.size()) {
+		// 5552 bytes is the most that can be summed before b could overflow
+		size_t end = std::min(data.size(), i + 5552);
+		for (; i < end; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+static std::array<uint32_t, 256> makeCrcTable() {
+	std::array<uint32_t, 256> table;
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+	return table;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+	// built once even with several encoder threads calling in at the same time
+	static const std::array<uint32_t, 256> table = makeCrcTable();
+
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static void appendChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+	appendBigEndian(png, static_cast<uint32_t>(data.size()));
+	size_t typeStart = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	appendBigEndian(png, crc32(png.data() + typeStart, png.size() - typeStart));
+}
+
+static int paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return pb <= pc ? b : c;
+}
+
+// the rows, each behind the filter type that makes its bytes closest to zero
+static void filterRows(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& filtered) {
+	const int rowBytes = width * 3;
+	filtered.resize(static_cast<size_t>(rowBytes + 1) * height);
+
+	std::vector<uint8_t> candidate(rowBytes);
+	for (int y = 0; y < height; y++) {
+		const uint8_t* row = rgb + static_cast<size_t>(y) * rowBytes;
+		const uint8_t* above = y > 0 ? row - rowBytes : nullptr;
+		uint8_t* out = filtered.data() + static_cast<size_t>(y) * (rowBytes + 1);
+
+		long bestCost = -1;
+		for (int type = 0; type < 5; type++) {
+			long cost = 0;
+			for (int i = 0; i < rowBytes; i++) {
+				int left = i >= 3 ? row[i - 3] : 0;
+				int up = above ? above[i] : 0;
+				int upLeft = (above && i >= 3) ? above[i - 3] : 0;
+
+				int predicted = 0;
+				if (type == 1) predicted = left;
+				else if (type == 2) predicted = up;
+				else if (type == 3) predicted = (left + up) / 2;
+				else if (type == 4) predicted = paeth(left, up, upLeft);
+
+				uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+				candidate[i] = value;
+				cost += value < 128 ? value : 256 - value;
+			}
+
+			if (bestCost < 0 || cost < bestCost) {
+				bestCost = cost;
+				out[0] = static_cast<uint8_t>(type);
+				std::copy(candidate.begin(), candidate.end(), out + 1);
+			}
+		}
+	}
+}
+
+void encodePNG(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& png) {
+	static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png.assign(SIGNATURE, SIGNATURE + 8);
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, static_cast<uint32_t>(width));
+	appendBigEndian(header, static_cast<uint32_t>(height));
+	header.push_back(8);	// bits per channel
+	header.push_back(2);	// RGB
+	header.push_back(0);	// deflate
+	header.push_back(0);	// adaptive filters
+	header.push_back(0);	// not interlaced
+	appendChunk(png, "IHDR", header);
+
+	std::vector<uint8_t> filtered;
+	filterRows(rgb, width, height, filtered);
+
+	// zlib stream: header for a 32K window and no dictionary, the data, its checksum
+	std::vector<uint8_t> compressed = { 0x78, 0x01 };
+	deflate(filtered, compressed);
+	appendBigEndian(compressed, adler32(filtered));
+	appendChunk(png, "IDAT", compressed);
+
+	appendChunk(png, "IEND", std::vector<uint8_t>());
+}
+
+bool writePNG(const std::string& path, const uint8_t* rgb, int width, int height) {
+	std::vector<uint8_t> png;
+	encodePNG(rgb, width, height, png);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(png.data()), png.size());
+	if (!file) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
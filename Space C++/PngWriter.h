@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 8-bit RGB PNG encoding with no dependencies, for the frames the software renderer makes.
+//
+// Each row gets the filter that leaves the smallest bytes, then the whole image is deflated
+// in one block with the fixed Huffman codes and greedy matches from a hash chain. Frames are
+// mostly black, which that compresses about as well as zlib does, and the output only
+// depends on the pixels, so the same frame always gives the same file.
+
+// rgb is width * height * 3 bytes, rows top to bottom
+void encodePNG(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& png);
+
+bool writePNG(const std::string& path, const uint8_t* rgb, int width, int height);
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// Independent random streams derived from the galaxy seed.
+// Every stream is identified by (seed, stream id, index), so any chunk of any
+// population can be regenerated on its own, on any thread, and come out the same.
+
+enum RandomStream : uint32_t {
+	RNG_STREAM_STARS = 1,
+	RNG_STREAM_STAR_CHUNK_ORDER,
+
+	// one per gas population, in GasType order
+	RNG_STREAM_GAS_MOLECULAR,
+	RNG_STREAM_GAS_COLD_NEUTRAL,
+	RNG_STREAM_GAS_WARM_NEUTRAL,
+	RNG_STREAM_GAS_WARM_IONIZED,
+	RNG_STREAM_GAS_HOT_IONIZED,
+	RNG_STREAM_GAS_CORONAL,
+};
+
+// SplitMix64 finaliser
+inline uint64_t mixSeed(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+inline uint32_t deriveStreamSeed(unsigned int seed, uint32_t stream, uint32_t index) {
+	uint64_t h = mixSeed(seed);
+	h = mixSeed(h ^ (static_cast<uint64_t>(stream) << 32 | index));
+	return static_cast<uint32_t>(h ^ (h >> 32));
+}
@@ -0,0 +1,169 @@
+#include "SelfTest.h"
+#include "ExponentialDisk.h"
+#include "OrbitKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// draws per sampler in the KS comparison
+const int DISK_TEST_SAMPLES = 200000;
+// the two-sample KS distance at 99.9% confidence is 1.95 * sqrt(2 / n); above it the table
+// and Newton don't draw from the same distribution
+const double DISK_TEST_KS_COEFFICIENT = 1.95;
+// largest |F(sample(u)) - u|: how far from the asked quantile the table's radius can be, mostly
+// in the first interval where the inverse goes as sqrt(2u) and the table is a straight line
+const double DISK_TEST_QUANTILE_BOUND = 1e-4;
+// points of the quantile sweep
+const int DISK_TEST_QUANTILES = 1 << 20;
+
+// orbitSinCos against std::sin/std::cos of the same float, over |angle| up to this
+const float SINCOS_TEST_RANGE = 8192.0f;
+const int SINCOS_TEST_SAMPLES = 1 << 22;
+const double SINCOS_TEST_BOUND = 8e-8;
+// computeOrbitXZ against std::cos/std::sin of the same double phase, w * t up to 1e9
+const size_t ORBIT_TEST_COUNT = 4093;	// not a multiple of any kernel's width, so the tails run too
+const double ORBIT_TEST_BOUND = 3e-7;
+
+static bool report(const char* name, double measured, double bound) {
+	bool passed = measured <= bound;
+	std::cout << (passed ? "  pass  " : "  FAIL  ") << name << ": " << measured << " (bound " << bound << ")" << std::endl;
+	return passed;
+}
+
+// largest gap between the empirical CDFs of a and b, both sorted
+static double ksDistance(const std::vector<double>& a, const std::vector<double>& b) {
+	double distance = 0.0;
+	size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size()) {
+		double x = std::min(a[i], b[j]);
+		while (i < a.size() && a[i] <= x) i++;
+		while (j < b.size() && b[j] <= x) j++;
+		distance = std::max(distance, std::fabs(i / (double)a.size() - j / (double)b.size()));
+	}
+	return distance;
+}
+
+// the table sampler against Newton on the same inverse CDF, at a few disk scales
+static bool testExponentialDisk() {
+	std::cout << "Exponential disk sampler against Newton" << std::endl;
+	bool passed = true;
+
+	const float scales[] = { 1.0f, 37.5f, 600.0f, 3000.0f };
+	for (float diskScale : scales) {
+		ExponentialDiskSampler sampler = makeExponentialDiskSampler(diskScale);
+
+		// independent draws, so this is a test of the distribution and not of the same u twice
+		std::mt19937 rng(12345);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		std::vector<double> table(DISK_TEST_SAMPLES), newton(DISK_TEST_SAMPLES);
+		for (int i = 0; i < DISK_TEST_SAMPLES; i++) table[i] = sampler.sample(uniform(rng)) / diskScale;
+		for (int i = 0; i < DISK_TEST_SAMPLES; i++) newton[i] = solveExponentialDiskCDF(uniform(rng));
+		std::sort(table.begin(), table.end());
+		std::sort(newton.begin(), newton.end());
+
+		double quantileError = 0.0;
+		for (int i = 0; i < DISK_TEST_QUANTILES; i++) {
+			float u = i / (float)DISK_TEST_QUANTILES;
+			quantileError = std::max(quantileError, std::fabs(exponentialDiskCDF(sampler.sample(u) / diskScale) - u));
+		}
+
+		std::cout << " disk scale " << diskScale << std::endl;
+		passed &= report("KS distance", ksDistance(table, newton),
+			DISK_TEST_KS_COEFFICIENT * std::sqrt(2.0 / DISK_TEST_SAMPLES));
+		passed &= report("quantile error", quantileError, DISK_TEST_QUANTILE_BOUND);
+	}
+	return passed;
+}
+
+// the polynomial sincos on its own, then every kernel this CPU has on whole arrays
+static bool testOrbitKernels() {
+	std::cout << "Orbit kernels against std::sin and std::cos" << std::endl;
+	bool passed = true;
+
+	// random angles, and the floats either side of multiples of PI/2 where the reduction cancels most
+	std::mt19937 rng(12345);
+	std::uniform_real_distribution<float> angles(-SINCOS_TEST_RANGE, SINCOS_TEST_RANGE);
+	double sinCosError = 0.0;
+	for (int i = 0; i < SINCOS_TEST_SAMPLES; i++) {
+		float angle = angles(rng);
+		if (i & 1) {
+			float quadrant = std::nearbyint(angle / 1.5707963267948966);
+			angle = std::nextafter(static_cast<float>(quadrant * 1.5707963267948966), (i & 2) ? 1e9f : -1e9f);
+		}
+		float s, c;
+		orbitSinCos(angle, s, c);
+		sinCosError = std::max(sinCosError, std::fabs(s - std::sin(static_cast<double>(angle))));
+		sinCosError = std::max(sinCosError, std::fabs(c - std::cos(static_cast<double>(angle))));
+	}
+	passed &= report("orbitSinCos error", sinCosError, SINCOS_TEST_BOUND);
+
+	std::vector<float> radius(ORBIT_TEST_COUNT, 1.0f), angle(ORBIT_TEST_COUNT), angularVelocity(ORBIT_TEST_COUNT);
+	std::uniform_real_distribution<float> startAngles(0.0f, 6.2831853f), velocities(-1.0f, 1.0f);
+	for (size_t i = 0; i < ORBIT_TEST_COUNT; i++) {
+		angle[i] = startAngles(rng);
+		angularVelocity[i] = velocities(rng);
+	}
+
+	const double times[] = { 0.0, 1.5, 1e3, 1e6, 1e9 };
+	const OrbitKernel kernel = activeOrbitKernel();
+	std::vector<float> x(ORBIT_TEST_COUNT), z(ORBIT_TEST_COUNT), scalarX, scalarZ;
+	for (int k = ORBIT_KERNEL_SCALAR; k <= ORBIT_KERNEL_AVX512; k++) {
+		setOrbitKernel(static_cast<OrbitKernel>(k));
+		if (activeOrbitKernel() != k) {
+			std::cout << "  skip  " << orbitKernelName(static_cast<OrbitKernel>(k)) << ": not supported" << std::endl;
+			continue;
+		}
+
+		// all kernels do the same operations in the same order, so they must match the scalar one exactly
+		double error = 0.0, mismatch = 0.0;
+		for (size_t t = 0; t < sizeof(times) / sizeof(times[0]); t++) {
+			const double time = times[t];
+			computeOrbitXZ(radius.data(), angle.data(), angularVelocity.data(), ORBIT_TEST_COUNT, time, x.data(), z.data());
+			for (size_t i = 0; i < ORBIT_TEST_COUNT; i++) {
+				double phase = static_cast<double>(angle[i]) + static_cast<double>(angularVelocity[i]) * time;
+				error = std::max(error, std::fabs(x[i] - std::cos(phase)));
+				error = std::max(error, std::fabs(z[i] - std::sin(phase)));
+			}
+
+			if (k == ORBIT_KERNEL_SCALAR) {
+				scalarX.insert(scalarX.end(), x.begin(), x.end());
+				scalarZ.insert(scalarZ.end(), z.begin(), z.end());
+				continue;
+			}
+			size_t offset = t * ORBIT_TEST_COUNT;
+			for (size_t i = 0; i < ORBIT_TEST_COUNT; i++) {
+				mismatch = std::max(mismatch, static_cast<double>(std::fabs(x[i] - scalarX[offset + i])));
+				mismatch = std::max(mismatch, static_cast<double>(std::fabs(z[i] - scalarZ[offset + i])));
+			}
+		}
+
+		std::string name = std::string(orbitKernelName(static_cast<OrbitKernel>(k))) + " kernel error";
+		passed &= report(name.c_str(), error, ORBIT_TEST_BOUND);
+		if (k != ORBIT_KERNEL_SCALAR) {
+			name = std::string(orbitKernelName(static_cast<OrbitKernel>(k))) + " difference from scalar";
+			passed &= report(name.c_str(), mismatch, 0.0);
+		}
+	}
+	setOrbitKernel(kernel);
+	return passed;
+}
+
+bool wantsSelfTest(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--self-test") == 0) return true;
+	}
+	return false;
+}
+
+int runSelfTests() {
+	bool passed = true;
+	passed &= testExponentialDisk();
+	passed &= testOrbitKernels();
+
+	std::cout << (passed ? "All checks passed" : "Some checks FAILED") << std::endl;
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Checks of the numerical shortcuts against the straightforward code they stand in for,
+// run with --self-test instead of the window. Each check prints what it measured next to
+// the bound it is held to.
+
+// true if the command line asks for the self-test
+bool wantsSelfTest(int argc, char** argv);
+// runs every check, returns the exit code: 0 if all of them pass
+int runSelfTests();
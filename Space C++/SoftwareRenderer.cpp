@@ -0,0 +1,848 @@
+#include "SoftwareRenderer.h"
+#include "Camera.h"
+#include "SolarSystem.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// the clear colour setupOpenGL sets
+const float BACKGROUND_COLOR[3] = { 0.0f, 0.0f, 0.02f };
+
+// GL point sizes are pixels of the 1080 line window, frames of other heights scale them
+const float REFERENCE_HEIGHT = 1080.0f;
+const float STAR_POINT_SIZE = 2.0f;
+// the largest size bin the GL gas renderer's point path has
+const float GAS_MAX_POINT_SIZE = 195.0f;
+const int GAS_SPRITE_MAX_LAYERS = 4;
+
+// chunks binning is split into, per thread; any split gives the same bins
+const size_t BIN_CHUNKS_PER_THREAD = 2 * PARALLEL_FOR_ALIGNMENT;
+const size_t BIN_MIN_CHUNK = 1024;
+
+struct Projection {
+	double clip[16];		// projection * modelview
+	double inverse[16];		// clip space back to world space
+	int width, height;
+	float pointScale;		// frame pixels per GL point size pixel
+};
+
+// items of the frame binned by the tiles they touch
+struct TileBins {
+	std::vector<uint32_t> start;		// tile t's items are items[start[t]] up to items[start[t + 1]]
+	std::vector<uint32_t> items;		// in scene order within a tile
+	std::vector<uint32_t> chunkOffsets;	// per chunk and tile, while binning
+};
+
+// tiles an item touches, inclusive
+struct TileRect {
+	int x0, y0, x1, y1;
+};
+
+// concentric discs of one cloud point, all layers that reach a pixel count there
+struct GasSprite {
+	float x, y;										// pixel centre
+	float extent;									// outermost radius in pixels
+	float radius2[GAS_SPRITE_MAX_LAYERS];			// squared, innermost first
+	float value[GAS_SPRITE_MAX_LAYERS];				// of the layers from this one out: darkening
+													// multiplied or alpha summed
+	float r, g, b;
+	int layers;
+	bool darkLane;
+};
+
+struct BlackHoleSplat {
+	const BlackHole* hole;
+	int x0, y0, x1, y1;								// pixels it may cover, inclusive
+	int diskLayers, diskRings, jetLayers, glowLayers;
+	bool centreVisible;								// glow points are dropped with their centre
+	float centreX, centreY;
+};
+
+static std::vector<float> starPositions;
+static std::vector<float> starScreen;		// x, y and depth per star, x is -FLT_MAX when out of view
+static TileBins starBins;
+
+static std::vector<float> cloudPositions;
+static std::vector<GasSprite> gasSprites;	// dark lanes first, like the GL renderer draws them
+static TileBins gasBins;
+
+static std::vector<BlackHoleSplat> blackHoleSplats;
+
+// by cofactors, false if m is singular
+static bool invertMatrix(const double* m, double* out) {
+	double inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+		m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] -
+		m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+		m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] -
+		m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] -
+		m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+		m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] -
+		m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+		m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+		m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] -
+		m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+		m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] -
+		m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] -
+		m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+		m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] -
+		m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+		m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	double det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0) return false;
+	for (int i = 0; i < 16; i++) out[i] = inv[i] / det;
+	return true;
+}
+
+// Frame pixel of a world point, false where GL would clip it. Points are dropped
+// as a whole when their centre is outside, whatever their size
+static bool projectPoint(const Projection& projection, double x, double y, double z, float& screenX, float& screenY,
+	float* depth = nullptr) {
+	const double* c = projection.clip;
+	double clipX = c[0] * x + c[4] * y + c[8] * z + c[12];
+	double clipY = c[1] * x + c[5] * y + c[9] * z + c[13];
+	double clipZ = c[2] * x + c[6] * y + c[10] * z + c[14];
+	double clipW = c[3] * x + c[7] * y + c[11] * z + c[15];
+
+	if (!(clipW > 0.0)) return false;
+	if (clipX < -clipW || clipX > clipW || clipY < -clipW || clipY > clipW) return false;
+	if (clipZ < -clipW || clipZ > clipW) return false;
+
+	screenX = static_cast<float>((clipX / clipW * 0.5 + 0.5) * projection.width);
+	screenY = static_cast<float>((0.5 - clipY / clipW * 0.5) * projection.height);
+	if (depth) *depth = static_cast<float>(clipW);
+	return true;
+}
+
+// the segment from the near to the far plane through a point of the frame, in world space
+static void pixelRay(const Projection& projection, double x, double y, double* origin, double* direction) {
+	double ndcX = x / projection.width * 2.0 - 1.0;
+	double ndcY = 1.0 - y / projection.height * 2.0;
+
+	double ends[2][3];
+	for (int e = 0; e < 2; e++) {
+		double ndcZ = e == 0 ? -1.0 : 1.0;
+		const double* m = projection.inverse;
+		double w = m[3] * ndcX + m[7] * ndcY + m[11] * ndcZ + m[15];
+		for (int i = 0; i < 3; i++) {
+			ends[e][i] = (m[i] * ndcX + m[4 + i] * ndcY + m[8 + i] * ndcZ + m[12 + i]) / w;
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		origin[i] = ends[0][i];
+		direction[i] = ends[1][i] - ends[0][i];
+	}
+}
+
+// the tiles the pixels under [x0, x1) x [y0, y1) fall in, false if none are in the frame
+static bool tilesUnder(const Projection& projection, float x0, float y0, float x1, float y1, TileRect& rect) {
+	int px0 = std::max(0, static_cast<int>(std::floor(x0)));
+	int py0 = std::max(0, static_cast<int>(std::floor(y0)));
+	int px1 = std::min(projection.width - 1, static_cast<int>(std::ceil(x1)) - 1);
+	int py1 = std::min(projection.height - 1, static_cast<int>(std::ceil(y1)) - 1);
+	if (px0 > px1 || py0 > py1) return false;
+
+	rect.x0 = px0 / SOFTWARE_TILE_SIZE;
+	rect.y0 = py0 / SOFTWARE_TILE_SIZE;
+	rect.x1 = px1 / SOFTWARE_TILE_SIZE;
+	rect.y1 = py1 / SOFTWARE_TILE_SIZE;
+	return true;
+}
+
+// A counting sort of items into the tiles they touch, done in chunks on the pool: each chunk
+// counts its items per tile, the counts become where each chunk writes in each tile, then
+// each chunk writes its items. Chunks keep their order within a tile, so the items do too.
+// footprint(i, rect) gives the tiles item i touches, false for none
+template <typename Footprint>
+static void binIntoTiles(size_t count, int tilesX, int tilesY, const Footprint& footprint, TileBins& bins) {
+	const size_t numTiles = static_cast<size_t>(tilesX) * tilesY;
+
+	size_t numChunks = std::min((count + BIN_MIN_CHUNK - 1) / BIN_MIN_CHUNK,
+		threadPoolSize(g_threadPool) * BIN_CHUNKS_PER_THREAD);
+	numChunks = std::max<size_t>(numChunks, 1);
+	const size_t chunkSize = (count + numChunks - 1) / numChunks;
+	bins.chunkOffsets.assign(numChunks * numTiles, 0);
+
+	auto forEachItem = [&](size_t chunk, uint32_t* tileEntries, bool write) {
+		size_t end = std::min(count, (chunk + 1) * chunkSize);
+		for (size_t i = chunk * chunkSize; i < end; i++) {
+			TileRect rect;
+			if (!footprint(i, rect)) continue;
+
+			for (int ty = rect.y0; ty <= rect.y1; ty++) {
+				for (int tx = rect.x0; tx <= rect.x1; tx++) {
+					uint32_t& entry = tileEntries[ty * tilesX + tx];
+					if (write) bins.items[entry] = static_cast<uint32_t>(i);
+					entry++;
+				}
+			}
+		}
+	};
+
+	parallelFor(g_threadPool, numChunks, 1, [&](size_t begin, size_t end) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			forEachItem(chunk, &bins.chunkOffsets[chunk * numTiles], false);
+		}
+	});
+
+	bins.start.resize(numTiles + 1);
+	uint32_t total = 0;
+	for (size_t t = 0; t < numTiles; t++) {
+		bins.start[t] = total;
+		for (size_t chunk = 0; chunk < numChunks; chunk++) {
+			uint32_t& entry = bins.chunkOffsets[chunk * numTiles + t];
+			uint32_t chunkCount = entry;
+			entry = total;
+			total += chunkCount;
+		}
+	}
+	bins.start[numTiles] = total;
+	bins.items.resize(total);
+
+	parallelFor(g_threadPool, numChunks, 1, [&](size_t begin, size_t end) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			forEachItem(chunk, &bins.chunkOffsets[chunk * numTiles], true);
+		}
+	});
+}
+
+static void projectStars(const Projection& projection, const StarField& stars, double time) {
+	const size_t count = stars.size();
+	starPositions.resize(count * 3);
+	starScreen.resize(count * 3);
+	computeStarPositions(stars, time, starPositions.data());
+
+	parallelFor(g_threadPool, count, 4096, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const float* p = &starPositions[i * 3];
+			float* screen = &starScreen[i * 3];
+			if (!projectPoint(projection, p[0], p[1], p[2], screen[0], screen[1], &screen[2])) {
+				screen[0] = -FLT_MAX;
+			}
+		}
+	});
+}
+
+// value[k] ends up covering the layers from k out
+static void addGasSprite(const Projection& projection, float x, float y, float z,
+	const float* sizes, const float* values, int layers, const GasCloud& cloud, bool darkLane) {
+	GasSprite sprite;
+	if (!projectPoint(projection, x, y, z, sprite.x, sprite.y)) return;
+
+	sprite.layers = layers;
+	sprite.darkLane = darkLane;
+	sprite.r = cloud.r;
+	sprite.g = cloud.g;
+	sprite.b = cloud.b;
+
+	float outward = darkLane ? 1.0f : 0.0f;
+	for (int i = layers - 1; i >= 0; i--) {
+		float radius = std::min(sizes[i], GAS_MAX_POINT_SIZE) * 0.5f * projection.pointScale;
+		sprite.radius2[i] = radius * radius;
+		outward = darkLane ? outward * values[i] : outward + values[i];
+		sprite.value[i] = outward;
+	}
+	sprite.extent = std::sqrt(sprite.radius2[layers - 1]);
+
+	gasSprites.push_back(sprite);
+}
+
+// the same points, sizes and colours renderGalacticGas draws without instancing
+static void buildGasSprites(const Projection& projection, const std::vector<GasCloud>& gasClouds,
+	double time, const RenderZone& zone) {
+	gasSprites.clear();
+	computeGasCloudPositions(gasClouds, time, cloudPositions);
+
+	int numFilaments = 3;
+	int numLayersPerFilament = 4;
+	if (zone.zoomLevel < 0.5) {
+		numFilaments = 2;
+		numLayersPerFilament = 3;
+	}
+
+	float sizes[GAS_SPRITE_MAX_LAYERS], values[GAS_SPRITE_MAX_LAYERS];
+
+	if (zone.zoomLevel >= 0.1) {
+		int numLayers = (zone.zoomLevel < 2.0) ? 3 : 4;
+
+		for (size_t c = 0; c < gasClouds.size(); c++) {
+			const GasCloud& cloud = gasClouds[c];
+			if (!cloud.isDarkLane) continue;
+
+			for (int i = 0; i < numLayers; i++) {
+				float t = i / (float)(numLayers - 1);
+				float w = cubicSplineKernel2D(t * cloud.smoothingLength * 2.0f, cloud.smoothingLength);
+				values[i] = std::min(1.0f, std::max(0.0f, 1.0f - cloud.alpha * 0.6f * w));
+				sizes[i] = cloud.smoothingLength * 2.0f * (1.0f + t * 0.3f);
+			}
+
+			addGasSprite(projection, cloudPositions[c * 2 + 0], cloud.y, cloudPositions[c * 2 + 1],
+				sizes, values, numLayers, cloud, true);
+		}
+	}
+
+	for (size_t c = 0; c < gasClouds.size(); c++) {
+		const GasCloud& cloud = gasClouds[c];
+		if (cloud.isDarkLane) continue;
+
+		if (zone.zoomLevel < 0.001 && cloud.type == GasType::CORONAL) continue;
+
+		const float baseSize = cloud.smoothingLength * 1.2f * (1.0f + cloud.elongation * 0.5f);
+		for (int f = 0; f < numFilaments; f++) {
+			const float filamentOffset = (f - numFilaments / 2) * cloud.smoothingLength * 0.4f;
+			const float filamentFalloff = std::exp(-f * f * 0.8f);
+
+			for (int i = 0; i < numLayersPerFilament; i++) {
+				float t = i / (float)(numLayersPerFilament - 1);
+				values[i] = std::min(1.0f, cloud.alpha * 0.8f * std::exp(-t * t * 2.5f) * filamentFalloff);
+				sizes[i] = baseSize * (1.0f + t * 0.2f);
+			}
+
+			addGasSprite(projection,
+				cloudPositions[c * 2 + 0] + filamentOffset * std::cos(cloud.rotationAngle), cloud.y,
+				cloudPositions[c * 2 + 1] + filamentOffset * std::sin(cloud.rotationAngle),
+				sizes, values, numLayersPerFilament, cloud, false);
+		}
+	}
+}
+
+// the same detail levels renderBlackHoles picks, and the pixels each hole can reach
+static void buildBlackHoleSplats(const Projection& projection, const std::vector<BlackHole>& blackHoles,
+	const RenderZone& zone) {
+	blackHoleSplats.clear();
+
+	for (const BlackHole& bh : blackHoles) {
+		BlackHoleSplat splat;
+		splat.hole = &bh;
+		if (zone.zoomLevel > 2000.0) {
+			splat.diskLayers = 4;
+			splat.diskRings = 40;
+			splat.jetLayers = 4;
+			splat.glowLayers = 12;
+		}
+		else if (zone.zoomLevel > 100.0) {
+			splat.diskLayers = 2;
+			splat.diskRings = 20;
+			splat.jetLayers = 3;
+			splat.glowLayers = 6;
+		}
+		else {
+			splat.diskLayers = 1;
+			splat.diskRings = 10;
+			splat.jetLayers = 2;
+			splat.glowLayers = 3;
+		}
+
+		// the corners of a cube around the disk and jets, its projection covers theirs
+		float diskReach = bh.accretionDiskOuterRadius * BLACK_HOLE_VISUAL_SCALE * (1.0f + (splat.diskLayers - 1) * 0.2f);
+		float jetReach = bh.accretionDiskOuterRadius * BLACK_HOLE_VISUAL_SCALE * 2.0f * (1.0f + (splat.jetLayers - 1) * 0.2f);
+		float reach = std::max(diskReach, jetReach);
+		float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+		bool wholeFrame = false;
+		for (int corner = 0; corner < 8 && !wholeFrame; corner++) {
+			double x = bh.x + ((corner & 1) ? reach : -reach);
+			double y = bh.y + ((corner & 2) ? reach : -reach);
+			double z = bh.z + ((corner & 4) ? reach : -reach);
+
+			const double* c = projection.clip;
+			double clipW = c[3] * x + c[7] * y + c[11] * z + c[15];
+			if (clipW <= 0.0) {
+				wholeFrame = true;
+				break;
+			}
+			float sx = static_cast<float>(((c[0] * x + c[4] * y + c[8] * z + c[12]) / clipW * 0.5 + 0.5) * projection.width);
+			float sy = static_cast<float>((0.5 - (c[1] * x + c[5] * y + c[9] * z + c[13]) / clipW * 0.5) * projection.height);
+			x0 = std::min(x0, sx);
+			y0 = std::min(y0, sy);
+			x1 = std::max(x1, sx);
+			y1 = std::max(y1, sy);
+		}
+		if (wholeFrame) {
+			x0 = y0 = 0.0f;
+			x1 = (float)projection.width;
+			y1 = (float)projection.height;
+		}
+
+		// glow points are sized in pixels, not world units
+		splat.centreVisible = projectPoint(projection, bh.x, bh.y, bh.z, splat.centreX, splat.centreY);
+		if (splat.centreVisible) {
+			float shadowRadius = bh.eventHorizonRadius * BLACK_HOLE_VISUAL_SCALE * 2.5f;
+			float glow = shadowRadius * (1.0f + (splat.glowLayers - 1) * 0.3f) * 0.5f * projection.pointScale;
+			x0 = std::min(x0, splat.centreX - glow);
+			y0 = std::min(y0, splat.centreY - glow);
+			x1 = std::max(x1, splat.centreX + glow);
+			y1 = std::max(y1, splat.centreY + glow);
+		}
+
+		splat.x0 = std::max(0, static_cast<int>(std::floor(x0)));
+		splat.y0 = std::max(0, static_cast<int>(std::floor(y0)));
+		splat.x1 = std::min(projection.width - 1, static_cast<int>(std::ceil(x1)));
+		splat.y1 = std::min(projection.height - 1, static_cast<int>(std::ceil(y1)));
+		if (splat.x0 > splat.x1 || splat.y0 > splat.y1) continue;
+
+		blackHoleSplats.push_back(splat);
+	}
+}
+
+// length of [a0, a1) that falls in [b, b + 1)
+static float overlap(float a0, float a1, float b) {
+	return std::max(0.0f, std::min(a1, b + 1.0f) - std::max(a0, b));
+}
+
+// Stars are opaque points drawn with the depth test, blended over the pixel by how much of it
+// they cover. So each pixel shows the nearest star that reached it, and they are taken in the
+// order GL draws them: a farther one drawn later fails the depth test, a nearer one covers it.
+// They aren't added up: the GL renderer draws them this way, and adding would brighten every
+// pixel many stars fall on, where the window shows about their mean colour
+static void drawTileStars(const Projection& projection, const StarField& stars, size_t tile,
+	int tileX, int tileY, int tileW, int tileH, float* accum, float* depth) {
+	const float half = STAR_POINT_SIZE * 0.5f * projection.pointScale;
+
+	for (uint32_t k = starBins.start[tile]; k < starBins.start[tile + 1]; k++) {
+		uint32_t i = starBins.items[k];
+		float x = starScreen[i * 3 + 0];
+		float y = starScreen[i * 3 + 1];
+		float w = starScreen[i * 3 + 2];
+
+		uint8_t rgba[4];
+		decodeStarColor(stars, i, rgba);
+		float r = rgba[0] * (1.0f / 255.0f), g = rgba[1] * (1.0f / 255.0f), b = rgba[2] * (1.0f / 255.0f);
+
+		int px0 = std::max(tileX, static_cast<int>(std::floor(x - half)));
+		int py0 = std::max(tileY, static_cast<int>(std::floor(y - half)));
+		int px1 = std::min(tileX + tileW - 1, static_cast<int>(std::ceil(x + half)) - 1);
+		int py1 = std::min(tileY + tileH - 1, static_cast<int>(std::ceil(y + half)) - 1);
+
+		for (int py = py0; py <= py1; py++) {
+			float coverY = overlap(y - half, y + half, (float)py);
+			float* row = accum + ((py - tileY) * SOFTWARE_TILE_SIZE) * 3;
+			float* depthRow = depth + (py - tileY) * SOFTWARE_TILE_SIZE;
+			for (int px = px0; px <= px1; px++) {
+				float cover = coverY * overlap(x - half, x + half, (float)px);
+				if (cover <= 0.0f || w >= depthRow[px - tileX]) continue;
+				depthRow[px - tileX] = w;
+
+				float* p = row + (px - tileX) * 3;
+				p[0] += (r - p[0]) * cover;
+				p[1] += (g - p[1]) * cover;
+				p[2] += (b - p[2]) * cover;
+			}
+		}
+	}
+}
+
+// each sprite multiplies (dark lanes) or adds (emissive) the value of the layers covering a pixel
+static void drawTileGas(size_t tile, int tileX, int tileY, int tileW, int tileH, float* accum) {
+	for (uint32_t k = gasBins.start[tile]; k < gasBins.start[tile + 1]; k++) {
+		const GasSprite& sprite = gasSprites[gasBins.items[k]];
+		const float outer2 = sprite.radius2[sprite.layers - 1];
+
+		// pixels whose centre is inside the outermost disc
+		int py0 = std::max(tileY, static_cast<int>(std::ceil(sprite.y - sprite.extent - 0.5f)));
+		int py1 = std::min(tileY + tileH - 1, static_cast<int>(std::floor(sprite.y + sprite.extent - 0.5f)));
+
+		for (int py = py0; py <= py1; py++) {
+			float dy = py + 0.5f - sprite.y;
+			float span2 = outer2 - dy * dy;
+			if (span2 < 0.0f) continue;
+			float span = std::sqrt(span2);
+
+			int px0 = std::max(tileX, static_cast<int>(std::ceil(sprite.x - span - 0.5f)));
+			int px1 = std::min(tileX + tileW - 1, static_cast<int>(std::floor(sprite.x + span - 0.5f)));
+			float* row = accum + ((py - tileY) * SOFTWARE_TILE_SIZE) * 3;
+
+			for (int px = px0; px <= px1; px++) {
+				float dx = px + 0.5f - sprite.x;
+				float d2 = dx * dx + dy * dy;
+				if (d2 > outer2) continue;
+
+				int layer = 0;
+				while (d2 > sprite.radius2[layer]) layer++;
+				float value = sprite.value[layer];
+
+				float* p = row + (px - tileX) * 3;
+				if (sprite.darkLane) {
+					p[0] *= value;
+					p[1] *= value;
+					p[2] *= value;
+				}
+				else {
+					p[0] += sprite.r * value;
+					p[1] += sprite.g * value;
+					p[2] += sprite.b * value;
+				}
+			}
+		}
+	}
+}
+
+// A pixel's ray, relative to a black hole. Points along it are origin + s * direction,
+// s from 0 at the near plane to 1 at the far plane
+struct HoleRay {
+	double origin[3], direction[3];
+};
+
+static void pointOnRay(const HoleRay& ray, double s, double* point) {
+	for (int i = 0; i < 3; i++) point[i] = ray.origin[i] + s * ray.direction[i];
+}
+
+// First crossing of a disk layer, a surface of revolution whose height is height(t) at
+// t along the disk from its inner edge. Found by stepping through the slab the layer fills and
+// bisecting the first step that crosses it. Returns false if it misses, else s, t and the hit
+struct DiskLayerShape {
+	double innerRadius, width;		// of the layer, scaled as drawn
+	double lowest, highest;			// heights it stays between
+	double maxT;					// the outermost ring
+	int side;
+};
+
+static double diskLayerHeight(const DiskLayerShape& shape, double t) {
+	double radius = shape.innerRadius + t * shape.width;
+	if (shape.side == 0) return -t * t * radius * 0.05;
+
+	double warp = (1.0 - t) * (1.0 - t);
+	double puff = (t > 0.6) ? std::pow((t - 0.6) / 0.4, 1.5) * 2.0 : 0.0;
+	return warp * radius * 0.3 + puff * radius * 0.15;
+}
+
+const int DISK_TRACE_STEPS = 24;
+const int DISK_TRACE_BISECTIONS = 10;
+
+static bool traceDiskLayer(const HoleRay& ray, const DiskLayerShape& shape, double& hitS, double* hit, double& hitT) {
+	if (ray.direction[1] == 0.0) return false;
+
+	// where the ray is between the layer's lowest and highest point
+	double s0 = (shape.lowest - ray.origin[1]) / ray.direction[1];
+	double s1 = (shape.highest - ray.origin[1]) / ray.direction[1];
+	if (s0 > s1) std::swap(s0, s1);
+	s0 = std::max(s0, 0.0);
+	s1 = std::min(s1, 1.0);
+	if (s0 > s1) return false;
+
+	// height above the layer at s, false where the ray is off the disk
+	auto above = [&](double s, double& value, double& t) {
+		double p[3];
+		pointOnRay(ray, s, p);
+		t = (std::sqrt(p[0] * p[0] + p[2] * p[2]) - shape.innerRadius) / shape.width;
+		if (t < 0.0 || t > shape.maxT) return false;
+		value = p[1] - diskLayerHeight(shape, t);
+		return true;
+	};
+
+	double previousS = s0, previousValue = 0.0, t;
+	bool previousOnDisk = above(s0, previousValue, t);
+	for (int step = 1; step <= DISK_TRACE_STEPS; step++) {
+		double s = s0 + (s1 - s0) * step / DISK_TRACE_STEPS;
+		double value;
+		bool onDisk = above(s, value, t);
+
+		if (onDisk && previousOnDisk && (value <= 0.0) != (previousValue <= 0.0)) {
+			double lo = previousS, hi = s, loValue = previousValue;
+			for (int i = 0; i < DISK_TRACE_BISECTIONS; i++) {
+				double mid = (lo + hi) * 0.5, midValue;
+				if (!above(mid, midValue, t)) break;
+				if ((midValue <= 0.0) == (loValue <= 0.0)) {
+					lo = mid;
+					loValue = midValue;
+				}
+				else {
+					hi = mid;
+				}
+			}
+			hitS = (lo + hi) * 0.5;
+			pointOnRay(ray, hitS, hit);
+			hitT = std::min(shape.maxT, std::max(0.0, (std::sqrt(hit[0] * hit[0] + hit[2] * hit[2]) - shape.innerRadius) / shape.width));
+			return true;
+		}
+
+		previousS = s;
+		previousValue = value;
+		previousOnDisk = onDisk;
+	}
+	return false;
+}
+
+// Nearest crossing of a jet's cone, which narrows from baseRadius at baseY to its apex at apexY.
+// f is 0 at the apex and 1 at the base
+static bool traceJet(const HoleRay& ray, double apexY, double baseY, double baseRadius, double& hitS, double& f) {
+	const double* o = ray.origin;
+	const double* d = ray.direction;
+	double k = baseRadius / (apexY - baseY);
+	double k2 = k * k;
+	double fromApex = apexY - o[1];
+
+	// x^2 + z^2 = (k * (apexY - y))^2 along the ray
+	double a = d[0] * d[0] + d[2] * d[2] - k2 * d[1] * d[1];
+	double b = 2.0 * (o[0] * d[0] + o[2] * d[2] + k2 * fromApex * d[1]);
+	double c = o[0] * o[0] + o[2] * o[2] - k2 * fromApex * fromApex;
+
+	double roots[2];
+	int numRoots = 0;
+	if (std::fabs(a) < 1e-12) {
+		if (b == 0.0) return false;
+		roots[numRoots++] = -c / b;
+	}
+	else {
+		double discriminant = b * b - 4.0 * a * c;
+		if (discriminant < 0.0) return false;
+		double root = std::sqrt(discriminant);
+		double r0 = (-b - root) / (2.0 * a), r1 = (-b + root) / (2.0 * a);
+		roots[numRoots++] = std::min(r0, r1);
+		roots[numRoots++] = std::max(r0, r1);
+	}
+
+	for (int i = 0; i < numRoots; i++) {
+		double s = roots[i];
+		if (s < 0.0 || s > 1.0) continue;
+
+		double y = o[1] + s * d[1];
+		double along = (apexY - y) / (apexY - baseY);
+		if (along < 0.0 || along > 1.0) continue;
+
+		hitS = s;
+		f = along;
+		return true;
+	}
+	return false;
+}
+
+// The parts renderBlackHoles draws, in its order and with its depth test: each part only
+// shows where it is nearer than what was drawn before it. Every part shows its nearest surface.
+// The photon ring lies inside the shadow sphere, which hides it, so it is left out
+static void drawBlackHolePixel(const Projection& projection, const BlackHoleSplat& splat, int px, int py,
+	float* p, float& depth) {
+	const BlackHole& bh = *splat.hole;
+	const float visualScale = BLACK_HOLE_VISUAL_SCALE;
+
+	HoleRay ray;
+	pixelRay(projection, px + 0.5, py + 0.5, ray.origin, ray.direction);
+	ray.origin[0] -= bh.x;
+	ray.origin[1] -= bh.y;
+	ray.origin[2] -= bh.z;
+
+	const double* c = projection.clip;
+	auto depthAt = [&](const double* relative) {
+		double x = relative[0] + bh.x, y = relative[1] + bh.y, z = relative[2] + bh.z;
+		return c[3] * x + c[7] * y + c[11] * z + c[15];
+	};
+
+	double nearest = depth;
+
+	for (int layer = 0; layer < splat.diskLayers; layer++) {
+		float layerAlpha = (layer == 0) ? 0.9f : (layer == 1) ? 0.5f : (layer == 2) ? 0.25f : 0.12f;
+		float layerScale = 1.0f + (float)layer * 0.2f;
+
+		for (int side = 0; side < 2; side++) {
+			DiskLayerShape shape;
+			shape.innerRadius = bh.accretionDiskInnerRadius * visualScale * layerScale;
+			shape.width = (bh.accretionDiskOuterRadius - bh.accretionDiskInnerRadius) * visualScale * layerScale;
+			shape.maxT = (splat.diskRings - 1) / (double)splat.diskRings;
+			shape.side = side;
+			double outerRadius = shape.innerRadius + shape.width;
+			shape.lowest = side == 0 ? -outerRadius * 0.05 : 0.0;
+			shape.highest = side == 0 ? 0.0 : outerRadius * 0.6;
+
+			double s, hit[3], t;
+			if (!traceDiskLayer(ray, shape, s, hit, t)) continue;
+			double depth = depthAt(hit);
+			if (depth >= nearest) continue;
+			nearest = depth;
+
+			float r, g, b;
+			accretionDiskColor((float)t, r, g, b);
+			float sideAlpha = (side == 0) ? 1.0f : 0.6f;
+			float brightness = (1.0f - (float)t * 0.65f) * layerAlpha * sideAlpha;
+			float cosA = (float)(hit[0] / std::sqrt(hit[0] * hit[0] + hit[2] * hit[2]));
+			float dopplerFactor = 1.0f + ((side == 0) ? 0.5f : 0.2f) * cosA;
+
+			// the colour is scaled by brightness and added scaled by it again as alpha
+			float weight = brightness * brightness * dopplerFactor;
+			p[0] += r * weight;
+			p[1] += g * weight;
+			p[2] += b * weight;
+		}
+	}
+
+	const double jetLength = bh.accretionDiskOuterRadius * visualScale * 2.0;
+	const double jetWidth = bh.accretionDiskInnerRadius * visualScale * 0.25;
+	for (int jetLayer = 0; jetLayer < splat.jetLayers; jetLayer++) {
+		float jetAlpha = (jetLayer == 0) ? 0.9f : (jetLayer == 1) ? 0.6f : (jetLayer == 2) ? 0.3f : 0.15f;
+		double jetScale = 1.0 + jetLayer * 0.2;
+		float greenR = (jetLayer == 0) ? 0.2f : 0.3f;
+		float greenG = (jetLayer == 0) ? 1.0f : 0.9f;
+		float greenB = (jetLayer == 0) ? 0.4f : 0.5f;
+
+		for (int direction = 1; direction >= -1; direction -= 2) {
+			double s, f;
+			if (!traceJet(ray, direction * jetLength * jetScale, direction * jetLength * 0.15,
+				jetWidth * jetScale, s, f)) continue;
+
+			double hit[3];
+			pointOnRay(ray, s, hit);
+			double depth = depthAt(hit);
+			if (depth >= nearest) continue;
+			nearest = depth;
+
+			// apex to base: the colour halves and alpha fades out
+			float shade = 1.0f - 0.5f * (float)f;
+			float alpha = jetAlpha * (1.0f - (float)f);
+			p[0] += greenR * shade * alpha;
+			p[1] += greenG * shade * alpha;
+			p[2] += greenB * shade * alpha;
+		}
+	}
+
+	const double shadowRadius = bh.eventHorizonRadius * visualScale * 2.5;
+	const double* o = ray.origin;
+	const double* d = ray.direction;
+	double a = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+	double halfB = o[0] * d[0] + o[1] * d[1] + o[2] * d[2];
+	double cc = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] - shadowRadius * shadowRadius;
+	double discriminant = halfB * halfB - a * cc;
+	if (discriminant >= 0.0) {
+		double root = std::sqrt(discriminant);
+		double s = (-halfB - root) / a;
+		if (s < 0.0) s = (-halfB + root) / a;
+		if (s >= 0.0 && s <= 1.0) {
+			double hit[3];
+			pointOnRay(ray, s, hit);
+			double depth = depthAt(hit);
+			if (depth < nearest) {
+				nearest = depth;
+				p[0] = p[1] = p[2] = 0.0f;
+			}
+		}
+	}
+
+	// The glow points all sit at the centre, so once the innermost one covering a pixel is
+	// drawn the rest fail the depth test there
+	depth = static_cast<float>(nearest);
+	if (!splat.centreVisible) return;
+	const double centre[3] = { 0.0, 0.0, 0.0 };
+	if (depthAt(centre) >= nearest) return;
+	depth = static_cast<float>(depthAt(centre));
+
+	float dx = px + 0.5f - splat.centreX, dy = py + 0.5f - splat.centreY;
+	float d2 = dx * dx + dy * dy;
+	for (int i = 0; i < splat.glowLayers; i++) {
+		float glowRadius = (float)shadowRadius * (1.0f + i * 0.3f) * 0.5f * projection.pointScale;
+		if (d2 > glowRadius * glowRadius) continue;
+
+		float glowAlpha = 0.25f / (1.0f + i * 0.5f);
+		p[0] += 1.0f * glowAlpha;
+		p[1] += 0.85f * glowAlpha;
+		p[2] += 0.5f * glowAlpha;
+		break;
+	}
+}
+
+static void drawTileBlackHoles(const Projection& projection, int tileX, int tileY, int tileW, int tileH,
+	float* accum, float* depth) {
+	for (const BlackHoleSplat& splat : blackHoleSplats) {
+		int px0 = std::max(tileX, splat.x0), px1 = std::min(tileX + tileW - 1, splat.x1);
+		int py0 = std::max(tileY, splat.y0), py1 = std::min(tileY + tileH - 1, splat.y1);
+
+		for (int py = py0; py <= py1; py++) {
+			for (int px = px0; px <= px1; px++) {
+				int index = (py - tileY) * SOFTWARE_TILE_SIZE + (px - tileX);
+				drawBlackHolePixel(projection, splat, px, py, accum + index * 3, depth[index]);
+			}
+		}
+	}
+}
+
+void renderSoftwareFrame(SoftwareFrame& frame, int width, int height, const StarField& stars,
+	const std::vector<GasCloud>& gasClouds, const std::vector<BlackHole>& blackHoles,
+	double time, const Camera& camera) {
+	frame.width = width;
+	frame.height = height;
+	frame.pixels.resize(static_cast<size_t>(width) * height * 3);
+
+	Projection projection;
+	double projectionMatrix[16], modelview[16];
+	cameraMatrices(camera, width, height, solarSystem, projectionMatrix, modelview);
+	multiplyMatrices(projectionMatrix, modelview, projection.clip);
+	invertMatrix(projection.clip, projection.inverse);
+	projection.width = width;
+	projection.height = height;
+	projection.pointScale = height / REFERENCE_HEIGHT;
+
+	RenderZone zone = calculateRenderZone(camera);
+
+	const int tilesX = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	const int tilesY = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+
+	projectStars(projection, stars, time);
+	const float starHalf = STAR_POINT_SIZE * 0.5f * projection.pointScale;
+	binIntoTiles(stars.size(), tilesX, tilesY, [&](size_t i, TileRect& rect) {
+		float x = starScreen[i * 3 + 0], y = starScreen[i * 3 + 1];
+		if (x == -FLT_MAX) return false;
+		return tilesUnder(projection, x - starHalf, y - starHalf, x + starHalf, y + starHalf, rect);
+	}, starBins);
+
+	buildGasSprites(projection, gasClouds, time, zone);
+	binIntoTiles(gasSprites.size(), tilesX, tilesY, [&](size_t i, TileRect& rect) {
+		const GasSprite& sprite = gasSprites[i];
+		return tilesUnder(projection, sprite.x - sprite.extent, sprite.y - sprite.extent,
+			sprite.x + sprite.extent, sprite.y + sprite.extent, rect);
+	}, gasBins);
+
+	buildBlackHoleSplats(projection, blackHoles, zone);
+
+	const size_t numTiles = static_cast<size_t>(tilesX) * tilesY;
+	parallelFor(g_threadPool, numTiles, 1, [&](size_t begin, size_t end) {
+		// rgb and the depth buffer
+		std::vector<float> accum(SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE * 3);
+		std::vector<float> depth(SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE);
+
+		for (size_t tile = begin; tile < end; tile++) {
+			int tileX = static_cast<int>(tile % tilesX) * SOFTWARE_TILE_SIZE;
+			int tileY = static_cast<int>(tile / tilesX) * SOFTWARE_TILE_SIZE;
+			int tileW = std::min(SOFTWARE_TILE_SIZE, width - tileX);
+			int tileH = std::min(SOFTWARE_TILE_SIZE, height - tileY);
+
+			for (size_t i = 0; i < accum.size(); i += 3) {
+				std::copy(BACKGROUND_COLOR, BACKGROUND_COLOR + 3, &accum[i]);
+			}
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+			drawTileStars(projection, stars, tile, tileX, tileY, tileW, tileH, accum.data(), depth.data());
+			drawTileGas(tile, tileX, tileY, tileW, tileH, accum.data());
+			drawTileBlackHoles(projection, tileX, tileY, tileW, tileH, accum.data(), depth.data());
+
+			for (int py = 0; py < tileH; py++) {
+				float* out = &frame.pixels[(static_cast<size_t>(tileY + py) * width + tileX) * 3];
+				const float* in = accum.data() + py * SOFTWARE_TILE_SIZE * 3;
+				std::copy(in, in + tileW * 3, out);
+			}
+		}
+	});
+}
+
+void softwareFrameToRGB8(const SoftwareFrame& frame, std::vector<uint8_t>& rgb) {
+	rgb.resize(frame.pixels.size());
+
+	parallelFor(g_threadPool, frame.pixels.size(), 65536, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			float value = std::min(1.0f, std::max(0.0f, frame.pixels[i]));
+			rgb[i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+		}
+	});
+}
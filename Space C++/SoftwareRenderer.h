@@ -0,0 +1,33 @@
+#pragma once
+#include "Stars.h"
+#include "GalacticGas.h"
+#include "BlackHole.h"
+#include <cstdint>
+#include <vector>
+
+struct Camera;
+
+// Draws the scene on the CPU, for machines without a GPU or a display.
+//
+// It follows the GL renderer: stars as 2 pixel points, then dark lanes multiplied in, then
+// the emissive gas added by alpha, then the black holes, with the same sizes, colours and
+// zoom-dependent detail. Everything is projected with the camera's own matrices and binned
+// into the square tiles of the frame it touches, in scene order; each tile is then drawn
+// start to finish by one thread. No two threads add to the same pixel and every pixel sees
+// its splats in the same order, so a frame comes out the same whatever the thread count.
+//
+// The frame is kept in floats and isn't clamped, softwareFrameToRGB8 does that on output.
+
+const int SOFTWARE_TILE_SIZE = 32;
+
+struct SoftwareFrame {
+	int width = 0, height = 0;
+	std::vector<float> pixels;		// rgb, rows top to bottom
+};
+
+void renderSoftwareFrame(SoftwareFrame& frame, int width, int height, const StarField& stars,
+	const std::vector<GasCloud>& gasClouds, const std::vector<BlackHole>& blackHoles,
+	double time, const Camera& camera);
+
+// clamped and rounded to 8 bits per channel, like the GL framebuffer stores it
+void softwareFrameToRGB8(const SoftwareFrame& frame, std::vector<uint8_t>& rgb);
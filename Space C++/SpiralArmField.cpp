@@ -0,0 +1,87 @@
+#include "SpiralArmField.h"
+#include "Stars.h"
+#include <cmath>
+#include <algorithm>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+float spiralArmAngle(float radius, const GalaxyConfig& config) {
+	float r = std::max(radius, 1e-3f);
+	return log(r / config.bulgeRadius) / config.spiralTightness;
+}
+
+float armProximityFromDistance(float radius, float minArmDistance, const GalaxyConfig& config) {
+	float radiusNorm = radius / static_cast<float>(config.diskRadius);
+	float edgeFactor = (radiusNorm > 1.0f) ? 1.0f : radiusNorm; // Clamp for calculation
+	float effectiveArmWidth = config.armWidth * (1.0f + edgeFactor * 1.5f);
+
+	return exp(-minArmDistance * minArmDistance / (effectiveArmWidth * effectiveArmWidth));
+}
+
+void buildSpiralArmField(SpiralArmField& field, const GalaxyConfig& config) {
+	field.numArms = std::max(1, config.numSpiralArms);
+	field.armSpacing = 2.0f * M_PI / field.numArms;
+	field.armWidth = static_cast<float>(config.armWidth);
+	field.maxRadius = static_cast<float>(config.diskRadius) * 2.0f;
+
+	field.radialStep = field.maxRadius / SPIRAL_FIELD_RADIAL_BINS;
+	field.angularStep = 2.0f * M_PI / SPIRAL_FIELD_ANGULAR_BINS;
+
+	const int rows = SPIRAL_FIELD_RADIAL_BINS + 1;
+	field.armDistance.resize(static_cast<size_t>(rows) * SPIRAL_FIELD_ANGULAR_BINS);
+	field.spiralAngle.resize(rows);
+
+	for (int i = 0; i < rows; i++) {
+		float radius = i * field.radialStep;
+		float spiralTheta = spiralArmAngle(radius, config);
+		field.spiralAngle[i] = spiralTheta;
+
+		float* distanceRow = &field.armDistance[static_cast<size_t>(i) * SPIRAL_FIELD_ANGULAR_BINS];
+
+		for (int j = 0; j < SPIRAL_FIELD_ANGULAR_BINS; j++) {
+			float theta = j * field.angularStep;
+
+			// arms are evenly spaced, so the nearest one is found from the phase within one spacing
+			float phase = fmod(theta - spiralTheta, field.armSpacing);
+			if (phase < 0.0f) phase += field.armSpacing;
+
+			distanceRow[j] = std::min(phase, field.armSpacing - phase) * radius;
+		}
+	}
+}
+
+// bilinear lookup in a (radius, angle) grid, wrapping around in angle
+static float sampleField(const SpiralArmField& field, const std::vector<float>& grid, float radius, float angle) {
+	float x = std::min(std::max(radius, 0.0f) / field.radialStep, (float)SPIRAL_FIELD_RADIAL_BINS);
+	int i0 = std::min(static_cast<int>(x), SPIRAL_FIELD_RADIAL_BINS - 1);
+	float fx = x - i0;
+
+	float y = angle / field.angularStep;
+	float fy0 = floor(y);
+	float fy = y - fy0;
+	int j0 = static_cast<int>(fy0) % SPIRAL_FIELD_ANGULAR_BINS;
+	if (j0 < 0) j0 += SPIRAL_FIELD_ANGULAR_BINS;
+	int j1 = (j0 + 1 == SPIRAL_FIELD_ANGULAR_BINS) ? 0 : j0 + 1;
+
+	const float* row0 = &grid[static_cast<size_t>(i0) * SPIRAL_FIELD_ANGULAR_BINS];
+	const float* row1 = row0 + SPIRAL_FIELD_ANGULAR_BINS;
+
+	float a = row0[j0] + (row0[j1] - row0[j0]) * fy;
+	float b = row1[j0] + (row1[j1] - row1[j0]) * fy;
+	return a + (b - a) * fx;
+}
+
+float SpiralArmField::distanceAt(float radius, float angle) const {
+	return sampleField(*this, armDistance, radius, angle);
+}
+
+float SpiralArmField::armCenterAngle(float radius, int arm) const {
+	float x = std::min(std::max(radius, 0.0f) / radialStep, (float)SPIRAL_FIELD_RADIAL_BINS);
+	int i0 = std::min(static_cast<int>(x), SPIRAL_FIELD_RADIAL_BINS - 1);
+	float fx = x - i0;
+
+	float theta = spiralAngle[i0] + (spiralAngle[i0 + 1] - spiralAngle[i0]) * fx;
+	return theta + arm * armSpacing;
+}
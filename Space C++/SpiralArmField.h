@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+
+struct GalaxyConfig;
+
+// Polar-grid resolution of the spiral arm field
+const int SPIRAL_FIELD_RADIAL_BINS = 512;
+const int SPIRAL_FIELD_ANGULAR_BINS = 1024;
+
+// Precomputed distance to the nearest spiral arm over the galactic plane.
+// Built once per GalaxyConfig and shared by the star and gas generators,
+// so both follow the same (configured) arms and query them in O(1).
+// Arm proximity isn't stored, armProximityFromDistance gets it from the distance.
+struct SpiralArmField {
+	int numArms;
+	float armSpacing;		// angle between neighbouring arms
+	float armWidth;
+	float maxRadius;		// radii beyond this are clamped to the last row
+
+	float radialStep;
+	float angularStep;
+
+	std::vector<float> armDistance;		// (RADIAL_BINS + 1) x ANGULAR_BINS, world units along the circle
+	std::vector<float> spiralAngle;		// RADIAL_BINS + 1, angle of arm 0 at each row's radius
+
+	float distanceAt(float radius, float angle) const;
+
+	// angle of the given arm's centre line at this radius
+	float armCenterAngle(float radius, int arm) const;
+};
+
+// Logarithmic spiral: r = a * e^(b * theta)
+// Solving for theta: theta = ln(r/a) / b
+float spiralArmAngle(float radius, const GalaxyConfig& config);
+
+// Arm proximity for a point minArmDistance away from the nearest arm at this radius.
+// Arms get wider towards the edge of the disk.
+float armProximityFromDistance(float radius, float minArmDistance, const GalaxyConfig& config);
+
+void buildSpiralArmField(SpiralArmField& field, const GalaxyConfig& config);
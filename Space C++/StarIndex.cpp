@@ -0,0 +1,370 @@
+#include "StarIndex.h"
+#include "Camera.h"
+#include "ThreadPool.h"
+#include "Orbit.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+const double TWO_PI = 6.283185307179586;
+
+// a cluster is drawn in place of its stars below this many pixels across
+const double STAR_CLUSTER_PIXELS = 2.0;
+
+// annulus stamps handed out so far, shared by every index
+static std::atomic<unsigned long long> starAnnulusStamps{ 0 };
+
+// a star of the annulus being binned, where it is relative to the annulus at the binned time
+struct BinnedStar {
+	uint32_t star;
+	float radius, angle, height, angularVelocity;
+};
+
+static float binnedStarCoordinate(const BinnedStar& star, int axis) {
+	return axis == 0 ? star.radius : (axis == 1 ? star.angle : star.height);
+}
+
+// fills in cluster `node` for members, which start at first in order, and splits it
+// in two halves along its widest extent until the halves are small enough
+static void buildClusterTree(std::vector<StarCluster>& clusters, uint32_t node, BinnedStar* members,
+	uint32_t first, uint32_t count, const StarField& stars, const StarAnnulus& annulus) {
+	double radius = 0.0, angle = 0.0, height = 0.0, angularVelocity = 0.0;
+	double color[3] = { 0.0, 0.0, 0.0 };
+	float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+	for (uint32_t i = 0; i < count; i++) {
+		const BinnedStar& member = members[i];
+		radius += member.radius;
+		angle += member.angle;
+		height += member.height;
+		angularVelocity += member.angularVelocity;
+
+		uint8_t rgba[4];
+		decodeStarColor(stars, member.star, rgba);
+		for (int c = 0; c < 3; c++) color[c] += rgba[c];
+
+		for (int axis = 0; axis < 3; axis++) {
+			low[axis] = std::min(low[axis], binnedStarCoordinate(member, axis));
+			high[axis] = std::max(high[axis], binnedStarCoordinate(member, axis));
+		}
+	}
+	radius /= count;
+	angle /= count;
+	height /= count;
+
+	StarCluster cluster;
+	cluster.first = first;
+	cluster.count = count;
+	cluster.children = 0;
+	cluster.radius = static_cast<float>(radius);
+	cluster.height = static_cast<float>(height);
+	cluster.angularVelocity = static_cast<float>(angularVelocity / count);
+	// back from the annulus' frame to an angle at time 0, as the stars' angles are stored
+	double turns = (angle + (annulus.meanAngularVelocity - cluster.angularVelocity) * annulus.binnedTime) *
+		(1.0 / TWO_PI);
+	cluster.angle = static_cast<float>((turns - std::floor(turns)) * TWO_PI);
+	for (int c = 0; c < 3; c++) cluster.color[c] = static_cast<uint8_t>(color[c] / count + 0.5);
+	cluster.color[3] = 255;
+
+	double centerX = radius * std::cos(angle), centerZ = radius * std::sin(angle);
+	double extent = 0.0, spread = 0.0;
+	for (uint32_t i = 0; i < count; i++) {
+		const BinnedStar& member = members[i];
+		double dx = member.radius * std::cos(member.angle) - centerX;
+		double dy = member.height - height;
+		double dz = member.radius * std::sin(member.angle) - centerZ;
+		extent = std::max(extent, dx * dx + dy * dy + dz * dz);
+		double drift = std::abs(member.angularVelocity - cluster.angularVelocity);
+		spread = std::max(spread, member.radius * drift);
+	}
+	cluster.extent = static_cast<float>(std::sqrt(extent));
+	cluster.minExtent = cluster.extent;
+	cluster.spread = static_cast<float>(spread);
+
+	if (count > STAR_CLUSTER_LEAF_SIZE) {
+		// widest in world units, angles count as arc length at the mean radius
+		float widths[3] = { high[0] - low[0], (high[1] - low[1]) * cluster.radius, high[2] - low[2] };
+		int axis = static_cast<int>(std::max_element(widths, widths + 3) - widths);
+
+		uint32_t half = count / 2;
+		std::nth_element(members, members + half, members + count, [axis](const BinnedStar& a, const BinnedStar& b) {
+			return binnedStarCoordinate(a, axis) < binnedStarCoordinate(b, axis);
+			});
+
+		cluster.children = static_cast<uint32_t>(clusters.size());
+		clusters.resize(clusters.size() + 2);
+		buildClusterTree(clusters, cluster.children, members, first, half, stars, annulus);
+		buildClusterTree(clusters, cluster.children + 1, members + half, first + half, count - half, stars, annulus);
+		cluster.minExtent = std::min(cluster.minExtent,
+			std::min(clusters[cluster.children].minExtent, clusters[cluster.children + 1].minExtent));
+	}
+
+	// the vector may have grown under the recursion
+	clusters[node] = cluster;
+}
+
+// sorts the annulus' span of order into its bins by the stars' angles at `time`,
+// and each bin into its cluster tree
+static void binAnnulus(StarIndex& index, int a, const StarField& stars, const float* velocities, double time) {
+	StarAnnulus& annulus = index.annuli[a];
+	uint32_t* span = &index.order[annulus.first];
+	annulus.binnedTime = time;
+
+	std::vector<BinnedStar> members(annulus.count);
+	std::vector<BinnedStar> sorted(annulus.count);
+	std::vector<uint16_t> bins(annulus.count);
+	uint32_t counts[ORBIT_INDEX_BINS] = {};
+
+	for (uint32_t i = 0; i < annulus.count; i++) {
+		BinnedStar& member = members[i];
+		member.star = span[i];
+		member.radius = decodeStarRadius(stars.scale, stars.radius[member.star]);
+		member.height = decodeStarHeight(stars.scale, stars.height[member.star]);
+		member.angularVelocity = velocities[starVelocityIndex(stars.radius[member.star], stars.type[member.star])];
+
+		double turns = annulusTurns(annulus, decodeStarAngle(stars.angle[member.star]), member.angularVelocity, time);
+		member.angle = static_cast<float>(turns * TWO_PI);
+
+		bins[i] = static_cast<uint16_t>(annulusBin(annulus, turns, member.height));
+		counts[bins[i]]++;
+	}
+
+	uint32_t* binStart = &index.binStart[a * ORBIT_INDEX_BINS];
+	uint32_t offset = 0;
+	for (int b = 0; b < ORBIT_INDEX_BINS; b++) {
+		binStart[b] = annulus.first + offset;
+		offset += counts[b];
+		counts[b] = binStart[b] - annulus.first;
+	}
+	for (uint32_t i = 0; i < annulus.count; i++) {
+		sorted[counts[bins[i]]++] = members[i];
+	}
+
+	annulus.clusters.clear();
+	uint32_t* binRoot = &index.binRoot[a * ORBIT_INDEX_BINS];
+	for (int b = 0; b < ORBIT_INDEX_BINS; b++) {
+		uint32_t first = binStart[b] - annulus.first;
+		uint32_t count = counts[b] - first;
+		binRoot[b] = static_cast<uint32_t>(annulus.clusters.size());
+		if (count == 0) continue;
+
+		annulus.clusters.emplace_back();
+		buildClusterTree(annulus.clusters, binRoot[b], &sorted[first], binStart[b], count, stars, annulus);
+	}
+
+	for (uint32_t i = 0; i < annulus.count; i++) {
+		span[i] = sorted[i].star;
+	}
+	annulus.stamp = ++starAnnulusStamps;
+}
+
+static void buildStarIndex(StarIndex& index, const StarField& stars, const float* velocities, double time) {
+	const size_t codes = static_cast<size_t>(STAR_CODE_STEPS);
+	const int numAnnuli = STAR_INDEX_DISK_ANNULI + STAR_INDEX_BULGE_ANNULI;
+
+	// radius code histograms, disk then bulge
+	std::vector<uint32_t> histogram(codes * 2, 0);
+	for (size_t i = 0; i < stars.size(); i++) {
+		histogram[(stars.type[i] >> 7) * codes + stars.radius[i]]++;
+	}
+
+	// cut each into annuli of about equal star counts
+	std::vector<uint8_t> annulusOfCode(codes * 2);
+	for (int family = 0; family < 2; family++) {
+		int firstAnnulus = family == 0 ? 0 : STAR_INDEX_DISK_ANNULI;
+		int familyAnnuli = family == 0 ? STAR_INDEX_DISK_ANNULI : STAR_INDEX_BULGE_ANNULI;
+
+		size_t total = 0;
+		for (size_t code = 0; code < codes; code++) total += histogram[family * codes + code];
+
+		size_t seen = 0;
+		for (size_t code = 0; code < codes; code++) {
+			int annulus = total ? static_cast<int>(seen * familyAnnuli / total) : 0;
+			annulusOfCode[family * codes + code] = static_cast<uint8_t>(firstAnnulus + annulus);
+			seen += histogram[family * codes + code];
+		}
+	}
+
+	index.annuli.assign(numAnnuli, StarAnnulus());
+	for (StarAnnulus& annulus : index.annuli) {
+		annulus.innerRadius = stars.scale.maxRadius;
+		annulus.outerRadius = 0.0f;
+		annulus.minHeight = stars.scale.maxHeight;
+		annulus.maxHeight = -stars.scale.maxHeight;
+		annulus.meanAngularVelocity = 0.0;
+		annulus.count = 0;
+	}
+
+	// each star's annulus, and what the annulus covers
+	std::vector<uint8_t> annulusOfStar(stars.size());
+	std::vector<float> minVelocity(numAnnuli, 1e30f), maxVelocity(numAnnuli, -1e30f);
+	for (size_t i = 0; i < stars.size(); i++) {
+		int a = annulusOfCode[(stars.type[i] >> 7) * codes + stars.radius[i]];
+		annulusOfStar[i] = static_cast<uint8_t>(a);
+
+		StarAnnulus& annulus = index.annuli[a];
+		float radius = decodeStarRadius(stars.scale, stars.radius[i]);
+		float height = decodeStarHeight(stars.scale, stars.height[i]);
+		float angularVelocity = velocities[starVelocityIndex(stars.radius[i], stars.type[i])];
+		annulus.innerRadius = std::min(annulus.innerRadius, radius);
+		annulus.outerRadius = std::max(annulus.outerRadius, radius);
+		annulus.minHeight = std::min(annulus.minHeight, height);
+		annulus.maxHeight = std::max(annulus.maxHeight, height);
+		annulus.meanAngularVelocity += angularVelocity;
+		minVelocity[a] = std::min(minVelocity[a], angularVelocity);
+		maxVelocity[a] = std::max(maxVelocity[a], angularVelocity);
+		annulus.count++;
+	}
+
+	uint32_t first = 0;
+	for (int a = 0; a < numAnnuli; a++) {
+		StarAnnulus& annulus = index.annuli[a];
+		annulus.first = first;
+		first += annulus.count;
+		if (annulus.count == 0) continue;
+
+		annulus.meanAngularVelocity /= annulus.count;
+		annulus.maxDrift = std::max(maxVelocity[a] - annulus.meanAngularVelocity,
+			annulus.meanAngularVelocity - minVelocity[a]);
+	}
+
+	// annuli are fixed by radius, so the stars only have to be grouped by them once
+	index.order.resize(stars.size());
+	std::vector<uint32_t> next(numAnnuli);
+	for (int a = 0; a < numAnnuli; a++) next[a] = index.annuli[a].first;
+	for (size_t i = 0; i < stars.size(); i++) {
+		index.order[next[annulusOfStar[i]]++] = static_cast<uint32_t>(i);
+	}
+
+	index.binStart.resize(numAnnuli * ORBIT_INDEX_BINS + 1);
+	index.binStart[numAnnuli * ORBIT_INDEX_BINS] = static_cast<uint32_t>(stars.size());
+	index.binRoot.resize(numAnnuli * ORBIT_INDEX_BINS);
+	parallelFor(g_threadPool, numAnnuli, 1, [&](size_t begin, size_t end) {
+		for (size_t a = begin; a < end; a++) {
+			binAnnulus(index, static_cast<int>(a), stars, velocities, time);
+		}
+		});
+
+	index.version = stars.version;
+	index.count = stars.size();
+}
+
+void updateStarIndex(StarIndex& index, const StarField& stars, double time) {
+	const float* velocities = starAngularVelocities(stars.scale);
+	if (stars.version != index.version || stars.size() != index.count) {
+		buildStarIndex(index, stars, velocities, time);
+		return;
+	}
+
+	std::vector<int> drifted;
+	for (int a = 0; a < static_cast<int>(index.annuli.size()); a++) {
+		if (annulusDrifted(index.annuli[a], time)) drifted.push_back(a);
+	}
+
+	parallelFor(g_threadPool, drifted.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			binAnnulus(index, drifted[i], stars, velocities, time);
+		}
+		});
+}
+
+static bool sphereInsideFrustum(const ViewFrustum& frustum, double x, double y, double z, double radius) {
+	for (int p = 0; p < 6; p++) {
+		const double* plane = frustum.planes[p];
+		if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < radius) return false;
+	}
+	return true;
+}
+
+static void addStarRange(std::vector<StarRange>& ranges, uint32_t first, uint32_t count) {
+	if (count == 0) return;
+	if (!ranges.empty() && ranges.back().first + ranges.back().count == first) {
+		ranges.back().count += count;
+		return;
+	}
+	ranges.push_back({ first, count });
+}
+
+// adds the stars of a visible bin's tree, or clusters in place of them where they are small enough
+static void findVisibleClusters(const StarIndex& index, uint32_t a, uint32_t root, const ViewFrustum& frustum,
+	double time, std::vector<StarRange>& ranges, std::vector<StarClusterRef>& visibleClusters) {
+	const StarAnnulus& annulus = index.annuli[a];
+	double spreadTime = std::abs(time - annulus.binnedTime);
+
+	uint32_t stack[64];
+	int depth = 0;
+	stack[depth++] = root;
+	while (depth > 0) {
+		uint32_t id = stack[--depth];
+		const StarCluster& cluster = annulus.clusters[id];
+
+		double angle = rotationAngleAt(cluster.angle, cluster.angularVelocity, time);
+		double x = cluster.radius * std::cos(angle);
+		double y = cluster.height;
+		double z = cluster.radius * std::sin(angle);
+		double radius = cluster.extent + cluster.spread * spreadTime + ORBIT_INDEX_DISTANCE_MARGIN;
+		if (!sphereInFrustum(frustum, x, y, z, radius)) continue;
+
+		double dx = x - frustum.eye[0], dy = y - frustum.eye[1], dz = z - frustum.eye[2];
+		double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		double nearest = distance - radius;
+		if (nearest > 0.0 && 2.0 * radius * frustum.pixelScale < STAR_CLUSTER_PIXELS * nearest) {
+			visibleClusters.push_back({ a, id });
+		} else if (cluster.children == 0 || (sphereInsideFrustum(frustum, x, y, z, radius) &&
+			2.0 * cluster.minExtent * frustum.pixelScale >= STAR_CLUSTER_PIXELS * (distance + radius))) {
+			// all in view, and not even the smallest cluster under it would be small enough
+			addStarRange(ranges, cluster.first, cluster.count);
+		} else {
+			// the first child's stars come first in order, it goes on top so ranges stay sorted
+			stack[depth++] = cluster.children + 1;
+			stack[depth++] = cluster.children;
+		}
+	}
+}
+
+// the visible stars and clusters of one sector of annulus a
+static void findVisibleInSector(const StarIndex& index, const ViewFrustum& frustum, double time, size_t a,
+	int sector, std::vector<StarRange>& ranges, std::vector<StarClusterRef>* clusters) {
+	const StarAnnulus& annulus = index.annuli[a];
+	const uint32_t* binStart = &index.binStart[a * ORBIT_INDEX_BINS];
+	int firstBin = sector * ORBIT_INDEX_SLABS;
+	if (binStart[firstBin] == binStart[firstBin + ORBIT_INDEX_SLABS]) return;
+	if (!annulusInFrustum(annulus, frustum, 0.0)) return;
+
+	SectorBounds bounds;
+	sectorBounds(annulus, sector, time, bounds);
+	if (!sphereInFrustum(frustum, bounds.x, bounds.middleHeight, bounds.z, bounds.sectorRadius)) return;
+
+	for (int slab = 0; slab < ORBIT_INDEX_SLABS; slab++) {
+		int bin = firstBin + slab;
+		if (binStart[bin] == binStart[bin + 1] ||
+			!sphereInFrustum(frustum, bounds.x, bounds.slabY(slab), bounds.z, bounds.slabRadius)) {
+			continue;
+		}
+
+		if (clusters) {
+			findVisibleClusters(index, static_cast<uint32_t>(a), index.binRoot[a * ORBIT_INDEX_BINS + bin],
+				frustum, time, ranges, *clusters);
+		} else {
+			addStarRange(ranges, binStart[bin], binStart[bin + 1] - binStart[bin]);
+		}
+	}
+}
+
+void findVisibleStars(const StarIndex& index, const ViewFrustum& frustum, double time,
+	std::vector<StarRange>& ranges, std::vector<StarClusterRef>* clusters) {
+	ranges.clear();
+	if (clusters) clusters->clear();
+
+	size_t numSlots = orbitIndexSlots(index.annuli.size());
+	std::vector<std::vector<StarRange>> slotRanges(numSlots);
+	std::vector<std::vector<StarClusterRef>> slotClusters(numSlots);
+
+	forEachSector(index.annuli.size(), [&](size_t a, int sector, size_t slot) {
+		findVisibleInSector(index, frustum, time, a, sector, slotRanges[slot], clusters ? &slotClusters[slot] : nullptr);
+		});
+
+	for (size_t slot = 0; slot < numSlots; slot++) {
+		for (const StarRange& range : slotRanges[slot]) addStarRange(ranges, range.first, range.count);
+		if (clusters) clusters->insert(clusters->end(), slotClusters[slot].begin(), slotClusters[slot].end());
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Stars.h"
+#include "OrbitIndex.h"
+#include <vector>
+#include <cstdint>
+
+struct ViewFrustum;
+
+// Stars binned by radius, angle and height so whole bins can be culled against the view.
+//
+// The turning annuli, sectors and slabs are OrbitIndex's; bulge and disk stars form annuli
+// apart, each cut into rings of equal star counts. Bulge stars all share one velocity and
+// never drift, the outer disk drifts slowly, only the innermost rings are binned again often.
+//
+// Each bin's stars are split further into a tree of clusters, halved along their widest
+// extent down to a few stars each. A cluster stands in for its stars where it would cover
+// less than a pixel: one point at their mean orbit with their mean colour. Stars are drawn
+// as opaque points, so where many fall on a pixel it shows about their mean colour anyway
+// and swapping them for the cluster keeps the image as bright as it was.
+
+const int STAR_INDEX_DISK_ANNULI = 64;
+const int STAR_INDEX_BULGE_ANNULI = 16;
+// clusters with more stars than this are split
+const int STAR_CLUSTER_LEAF_SIZE = 16;
+
+// A node of a bin's cluster tree, its stars are a span of order
+struct StarCluster {
+	uint32_t first, count;
+	uint32_t children;			// the first of two in the annulus' clusters, 0 for a leaf
+
+	// the stars' mean orbit, like a star's: angle at time 0 and angular velocity
+	float radius, angle, angularVelocity, height;
+	float extent;				// farthest star from that point when binned
+	float minExtent;			// the smallest extent in its tree, below it no part can stand in
+	float spread;				// how fast the stars can move away from it, world units per second
+	uint8_t color[4];			// mean colour of the stars
+};
+
+// radii are the stars' decoded ones
+struct StarAnnulus : OrbitAnnulus {
+	unsigned long long stamp;			// new whenever its stars are binned, for re-uploading the span
+
+	std::vector<StarCluster> clusters;	// every bin's tree, a node before its children
+};
+
+struct StarIndex {
+	std::vector<uint32_t> order;		// star indices by annulus, then bin
+	std::vector<uint32_t> binStart;		// bin b of annulus a starts at order[binStart[a * ORBIT_INDEX_BINS + b]]
+	std::vector<uint32_t> binRoot;		// and its tree starts at annuli[a].clusters[binRoot[a * ORBIT_INDEX_BINS + b]]
+	std::vector<StarAnnulus> annuli;	// disk annuli first, then bulge
+
+	unsigned long long version = 0;		// of the field it indexes
+	size_t count = 0;
+};
+
+// a span of order
+struct StarRange {
+	uint32_t first, count;
+};
+
+// a cluster to draw in place of its stars
+struct StarClusterRef {
+	uint32_t annulus, cluster;
+};
+
+// Brings the index up to date with the field: rebuilt if the field changed,
+// otherwise only the annuli that drifted too far at `time` are binned again
+void updateStarIndex(StarIndex& index, const StarField& stars, double time);
+
+// The spans of order that may be in view at `time`, in order and with neighbours merged.
+// Culls annuli, then sectors, then slabs, then clusters by bounding spheres; stars outside
+// the frustum can come back, none inside it are left out.
+// With clusters given, a cluster that would cover less than a pixel goes there instead of its
+// stars; without, every star in view is in the ranges
+void findVisibleStars(const StarIndex& index, const ViewFrustum& frustum, double time,
+	std::vector<StarRange>& ranges, std::vector<StarClusterRef>* clusters = nullptr);
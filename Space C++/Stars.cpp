@@ -1,9 +1,22 @@
 ﻿#include "Stars.h"
 #include "SolarSystem.h"
-#include <GLFW/glfw3.h>
+#include "Random.h"
+#include "ExponentialDisk.h"
+#include "SpiralArmField.h"
+#include "Orbit.h"
+#include "OrbitKernels.h"
+#include "ThreadPool.h"
+#include "GLExtensions.h"
+#include "StreamBuffer.h"
+#include "StarIndex.h"
+#include "Camera.h"
 #include <iostream>
 #include <cmath>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -15,7 +28,7 @@ struct StarType {
 	float probability;
 };
 
-const StarType starTypes[] = {
+const StarType starTypes[NUM_STAR_TYPES] = {
 	{0.6f, 0.7f, 1.0f, 0.05f},   // O - Blue (very hot, rare)
 	{0.7f, 0.8f, 1.0f, 0.10f},   // B - Blue-white (hot)
 	{0.9f, 0.9f, 1.0f, 0.15f},   // A - White (hot)
@@ -25,21 +38,186 @@ const StarType starTypes[] = {
 	{1.0f, 0.6f, 0.5f, 0.10f}    // M - Red (cool, common)
 };
 
-void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config) {
-	std::mt19937 rng(config.seed);
+// Resolution of the disk acceptance table: radius x angle-to-arm
+const int DISK_TABLE_RADIAL_BINS = 1024;
+const int DISK_TABLE_PHASE_BINS = 512;
+
+struct AliasEntry {
+	float probability;
+	int alias;
+};
+
+// Joint (radius, arm phase) distribution of accepted disk stars.
+// The radial axis has one extra bin at the very end holding the stars clamped to maxRadius.
+struct DiskSamplingTable {
+	float maxRadius;
+	float radialStep;
+	float phaseStep;
+	float armSpacing;
+	int numArms;
+	float bulgeFraction;
+
+	std::vector<AliasEntry> radial;   // DISK_TABLE_RADIAL_BINS + 1 entries
+	std::vector<AliasEntry> phase;    // DISK_TABLE_PHASE_BINS entries per radial bin
+};
+
+// Probability that a disk candidate at this radius and distance from the nearest arm survives.
+static float diskAcceptProbability(float radius, float minArmDistance, const GalaxyConfig& config) {
+	float radiusNorm = radius / static_cast<float>(config.diskRadius);
+
+	// Stars close to arms have high probability, far from arms very low
+	float armProximity = armProximityFromDistance(radius, minArmDistance, config);
+
+	float acceptProbability;
+	if (radius > config.diskRadius) {
+		// we over the disk radius, this is the outlier region
+		// split into multiple zones for smoother transition
+		float excessRadius = radius - config.diskRadius;
+		float fadeScale = config.diskRadius * 0.15f;
+
+		float outlierFactor = exp(-excessRadius / fadeScale);
+
+		// quadratic suppression for extreme outliers
+		if (radiusNorm > 1.3f) {
+			float extremeFactor = 1.3f / radiusNorm;
+			outlierFactor *= extremeFactor * extremeFactor;
+		}
+
+		// 8% of normal density
+		acceptProbability = outlierFactor * 0.08f;
+	}
+	else if (radius > config.diskRadius * 0.85f) {
+		// Transition zone (85% - 100% of diskRadius) with gradual fadeout
+		float transitionFactor = (config.diskRadius - radius) / (config.diskRadius * 0.15f);
+		transitionFactor = 0.5f + 0.5f * transitionFactor;
+
+		float densityWeight = armProximity * config.armDensityBoost;
+		acceptProbability = (1.0f + densityWeight) / (1.0f + config.armDensityBoost);
+
+		// 80% rejection for inter-arm regions
+		if (armProximity < 0.3f) {
+			acceptProbability *= 0.2f;
+		}
+
+		acceptProbability *= transitionFactor;
+	}
+	else {
+		float densityWeight = armProximity * config.armDensityBoost;
+		acceptProbability = (1.0f + densityWeight) / (1.0f + config.armDensityBoost);
+
+		// 80% rejection for inter-arm regions
+		if (armProximity < 0.3f) {
+			acceptProbability *= 0.2f;
+		}
+	}
+
+	return acceptProbability;
+}
+
+// Vose's alias method: O(1) sampling from a discrete distribution
+static void buildAliasTable(AliasEntry* out, const double* weights, int n) {
+	double total = 0.0;
+	for (int i = 0; i < n; i++) total += weights[i];
+
+	std::vector<double> scaled(n);
+	std::vector<int> small, large;
+	for (int i = 0; i < n; i++) {
+		scaled[i] = (total > 0.0) ? weights[i] * n / total : 1.0;
+		out[i].alias = i;
+		(scaled[i] < 1.0 ? small : large).push_back(i);
+	}
+
+	while (!small.empty() && !large.empty()) {
+		int s = small.back(); small.pop_back();
+		int l = large.back();
+
+		out[s].probability = static_cast<float>(scaled[s]);
+		out[s].alias = l;
+
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	for (int i : small) out[i].probability = 1.0f;
+	for (int i : large) out[i].probability = 1.0f;
+}
+
+static int sampleAlias(const AliasEntry* table, int n, float u) {
+	float x = u * n;
+	int i = std::min(static_cast<int>(x), n - 1);
+	return (x - i < table[i].probability) ? i : table[i].alias;
+}
+
+// Folds the old rejection sampler into a table: each cell's weight is the exponential-disk
+// radial mass of its radius bin times the acceptance probability at its arm phase.
+// Arms are evenly spaced, so the angle only matters modulo the arm spacing.
+static void buildDiskSamplingTable(DiskSamplingTable& table, const GalaxyConfig& config,
+	const SpiralArmField& armField) {
+	table.numArms = armField.numArms;
+	table.maxRadius = static_cast<float>(config.diskRadius) * 2.0f; // allow 2x radius to allow stars beyond diskRadius to fade out (not creating an uniform circle)
+	table.radialStep = table.maxRadius / DISK_TABLE_RADIAL_BINS;
+	table.armSpacing = armField.armSpacing;
+	table.phaseStep = table.armSpacing / DISK_TABLE_PHASE_BINS;
+
+	const double diskScale = config.diskRadius * 0.25; // tune to taste
+	auto diskCDF = [&](double r) {
+		return exponentialDiskCDF(r / diskScale);
+	};
+
+	table.radial.resize(DISK_TABLE_RADIAL_BINS + 1);
+	table.phase.resize(static_cast<size_t>(DISK_TABLE_RADIAL_BINS + 1) * DISK_TABLE_PHASE_BINS);
+
+	std::vector<double> radialWeights(DISK_TABLE_RADIAL_BINS + 1);
+	std::vector<double> phaseWeights(DISK_TABLE_PHASE_BINS);
+	double acceptedMass = 0.0;
+
+	for (int ir = 0; ir <= DISK_TABLE_RADIAL_BINS; ir++) {
+		// the last bin is everything the old sampler clamped to maxRadius
+		bool tail = (ir == DISK_TABLE_RADIAL_BINS);
+		double radialMass = tail ? 1.0 - diskCDF(table.maxRadius)
+			: diskCDF((ir + 1) * table.radialStep) - diskCDF(ir * table.radialStep);
+		float radius = tail ? table.maxRadius : (ir + 0.5f) * table.radialStep;
+
+		double meanAccept = 0.0;
+		for (int ip = 0; ip < DISK_TABLE_PHASE_BINS; ip++) {
+			float phase = (ip + 0.5f) * table.phaseStep;
+			float minArmDistance = std::min(phase, table.armSpacing - phase) * radius;
+
+			phaseWeights[ip] = diskAcceptProbability(radius, minArmDistance, config);
+			meanAccept += phaseWeights[ip];
+		}
+		meanAccept /= DISK_TABLE_PHASE_BINS;
+
+		buildAliasTable(&table.phase[ir * DISK_TABLE_PHASE_BINS], phaseWeights.data(), DISK_TABLE_PHASE_BINS);
+		radialWeights[ir] = radialMass * meanAccept;
+		acceptedMass += radialWeights[ir];
+	}
+
+	buildAliasTable(table.radial.data(), radialWeights.data(), DISK_TABLE_RADIAL_BINS + 1);
+
+	// the rejection sampler re-rolled the bulge/disk choice on every rejected candidate,
+	// so 15% of candidates ended up as a larger share of the accepted stars
+	const double bulgeCandidateFraction = 0.15;
+	table.bulgeFraction = static_cast<float>(bulgeCandidateFraction /
+		(bulgeCandidateFraction + (1.0 - bulgeCandidateFraction) * acceptedMass));
+}
+
+// Generates one chunk of stars from that chunk's own random stream.
+// Nothing in here touches shared state, so chunks can run on any thread in any order.
+static void generateStarChunk(StarField& stars, int begin, int count, const GalaxyConfig& config,
+	const DiskSamplingTable& table, const SpiralArmField& armField, std::mt19937& rng) {
 	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
 	std::normal_distribution<float> normalDist(0.0f, 1.0f);
 
-	stars.clear();
-	stars.reserve(config.numStars);
-
-	for (int i = 0; i < config.numStars; i++) {
+	for (int i = 0; i < count; i++) {
 		Star star;
 
 		// Decide if star is in bulge or disk
 		// bulge = the spherical central region
 		// disk = the flat rotating part with spiral arms
-		bool inBulge = dist(rng) < 0.15f; // 15%
+		bool inBulge = dist(rng) < table.bulgeFraction;
 
 		if (inBulge) {
 			// spherical distribution
@@ -54,127 +232,25 @@ void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config) {
 			// rotation (in union) for bulge stars
 			star.radius = sqrt(star.x * star.x + star.z * star.z);
 			star.angle = atan2(star.z, star.x);
-
-			// higher velocity since bulge rotates faster
-			star.angularVelocity = config.rotationSpeed * 0.5f / (config.bulgeRadius + 1.0f);
 		}
 		else {
 			// disk & arms
+			// (radius, angle to nearest arm) is drawn straight from the acceptance table,
+			// so there is no retry loop and every disk star costs the same
+			int radialBin = sampleAlias(table.radial.data(), DISK_TABLE_RADIAL_BINS + 1, dist(rng));
+			int phaseBin = sampleAlias(&table.phase[radialBin * DISK_TABLE_PHASE_BINS], DISK_TABLE_PHASE_BINS, dist(rng));
 
-			// Exponential disk sampling
-			// Radial surface density: Sigma(r) ∝ exp(-r/rd)
-			// Radial PDF (per radius) ∝ r * exp(-r/rd)
-			// CDF: F(r) = 1 - (1 + r/rd) * exp(-r/rd)
-			// Invert F numerically (Newton) to get r for uniform u in [0,1].
-			auto sampleExponentialDiskRadius = [&](float diskScale) -> float {
-				float u = dist(rng);
-				// initial guess: exponential inverse (not exact for r*e^{-r/rd} but a reasonable start)
-				float r = -diskScale * std::log(1.0f - u + 1e-8f);
-				// Newton iteration to solve F(r) - u = 0
-				for (int it = 0; it < 10; ++it) {
-					float t = r / diskScale;
-					float expNegT = std::exp(-t);
-					float F = 1.0f - (1.0f + t) * expNegT;        // F(r)
-					float G = F - u;							  // want G == 0
-
-					if (std::fabs(G) < 1e-6f) break;
-					// dF/dr = (r / rd^2) * exp(-r/rd)
-					float dFdr = (r == 0.0f) ? (1.0f / (diskScale)) * 0.0f : (r / (diskScale * diskScale)) * expNegT;
-					// fallback if derivative is too small
-					if (dFdr <= 1e-12f) break;
-					float delta = G / dFdr;
-					r -= delta;
-					if (r < 0.0f) { r = 0.0f; break; }
-				}
-				return r;
-				};
-
-			float diskScale = static_cast<float>(config.diskRadius) * 0.25f; // tune to taste
-			float radius = sampleExponentialDiskRadius(diskScale);
-
-			float maxRadius = static_cast<float>(config.diskRadius) * 2.0f; // allow 2x radius to allow stars beyond diskRadius to fade out (not creating an uniform circle)
-			if (radius > maxRadius) {
-				radius = maxRadius;
-			}
-
-			// Base angle
-			float theta = dist(rng) * 2.0f * M_PI;
-
-			// Calculate distance to nearest spiral arm
-			float minArmDistance = 1e10f;
+			float radius = (radialBin == DISK_TABLE_RADIAL_BINS) ? table.maxRadius
+				: (radialBin + dist(rng)) * table.radialStep;
+			float phase = (phaseBin + dist(rng)) * table.phaseStep;
 
-			for (int arm = 0; arm < config.numSpiralArms; arm++) {
-				// Logarithmic spiral: r = a * e^(b * theta)
-				// Solving for theta: theta = ln(r/a) / b
-				float armOffset = (arm * 2.0f * M_PI) / config.numSpiralArms;
-
-				// Calculate where this radius intersects the spiral arm
-				float spiralTheta = log(radius / config.bulgeRadius) / config.spiralTightness + armOffset;
-
-				// Normalize angle difference to [-PI, PI]
-				float angleDiff = theta - spiralTheta;
-				while (angleDiff > M_PI) angleDiff -= 2.0f * M_PI;
-				while (angleDiff < -M_PI) angleDiff += 2.0f * M_PI;
-
-				// Convert angle difference to distance at this radius
-				float armDistance = fabs(angleDiff * radius);
-				minArmDistance = fmin(minArmDistance, armDistance);
-			}
+			int arm = std::min(static_cast<int>(dist(rng) * table.numArms), table.numArms - 1);
+			float theta = armField.armCenterAngle(radius, arm) + phase;
+			theta = fmod(theta, 2.0f * M_PI);
+			if (theta < 0.0f) theta += 2.0f * M_PI;
 
 			float radiusNorm = radius / static_cast<float>(config.diskRadius);
 			float edgeFactor = (radiusNorm > 1.0f) ? 1.0f : radiusNorm; // Clamp for calculation
-			float effectiveArmWidth = config.armWidth * (1.0f + edgeFactor * 1.5f); // Arms get wider towards edges
-
-			// Stars close to arms have high probability, far from arms very low
-			float armProximity = exp(-minArmDistance * minArmDistance / (effectiveArmWidth * effectiveArmWidth));
-
-			float acceptProbability;
-			if (radius > config.diskRadius) {
-				// we over the disk radius, this is the outlier region
-				// split into multiple zones for smoother transition
-				float excessRadius = radius - config.diskRadius;
-				float fadeScale = config.diskRadius * 0.15f;
-				
-				float outlierFactor = exp(-excessRadius / fadeScale);
-				
-				// quadratic suppression for extreme outliers
-				if (radiusNorm > 1.3f) {
-					float extremeFactor = 1.3f / radiusNorm;
-					outlierFactor *= extremeFactor * extremeFactor;
-				}
-				
-				// 8% of normal density
-				acceptProbability = outlierFactor * 0.08f;
-			}
-			else if (radius > config.diskRadius * 0.85f) {
-				// Transition zone (85% - 100% of diskRadius) with gradual fadeout
-				float transitionFactor = (config.diskRadius - radius) / (config.diskRadius * 0.15f);
-				transitionFactor = 0.5f + 0.5f * transitionFactor;
-				
-				float densityWeight = armProximity * config.armDensityBoost;
-				acceptProbability = (1.0f + densityWeight) / (1.0f + config.armDensityBoost);
-
-				// 80% rejection for inter-arm regions
-				if (armProximity < 0.3f) {
-					acceptProbability *= 0.2f;
-				}
-				
-				acceptProbability *= transitionFactor;
-			}
-			else {
-				float densityWeight = armProximity * config.armDensityBoost;
-				acceptProbability = (1.0f + densityWeight) / (1.0f + config.armDensityBoost);
-
-				// 80% rejection for inter-arm regions
-				if (armProximity < 0.3f) {
-					acceptProbability *= 0.2f;
-				}
-			}
-
-			if (dist(rng) > acceptProbability) {
-				i--;  // Retry this star
-				continue;
-			}
 
 			// positional noise for irregular edges
 			float noiseScale = 15.0f * (1.0f + radiusNorm * 0.8f);
@@ -193,16 +269,15 @@ void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config) {
 			// rotation for disk stars
 			star.radius = radius;
 			star.angle = theta;
-			// outer stars rotate slower
-			star.angularVelocity = config.rotationSpeed * 1.0f / (sqrt(radius / config.bulgeRadius) * (radius + 1.0f));
 		}
+		star.inBulge = inBulge;
 
 		// select star type
 		float typeRoll = dist(rng);
 		float cumulative = 0.0f;
 		int selectedType = 6; // default M type
 
-		for (int t = 0; t < 7; t++) {
+		for (int t = 0; t < NUM_STAR_TYPES; t++) {
 			cumulative += starTypes[t].probability;
 			if (typeRoll <= cumulative) {
 				selectedType = t;
@@ -210,9 +285,7 @@ void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config) {
 			}
 		}
 
-		star.r = starTypes[selectedType].r;
-		star.g = starTypes[selectedType].g;
-		star.b = starTypes[selectedType].b;
+		star.type = selectedType;
 
 		// stars in bulge tend to be older
 		float distFromCenter = sqrt(star.x * star.x + star.y * star.y + star.z * star.z);
@@ -223,56 +296,685 @@ void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config) {
 			star.brightness = 0.3f + dist(rng) * 0.7f; // bright
 
 			// stars in spiral arms are brighter
-			float minArmDist = 1e10f;
+			float minArmDist = armField.distanceAt(star.radius, star.angle);
+			float armBrightness = exp(-minArmDist * minArmDist / (config.armWidth * config.armWidth * 4.0f));
 
-			for (int arm = 0; arm < config.numSpiralArms; arm++) {
-				float armOffset = (arm * 2.0f * M_PI) / config.numSpiralArms;
-				float spiralTheta = log(star.radius / config.bulgeRadius) / config.spiralTightness + armOffset;
-				float angleDiff = star.angle - spiralTheta;
+			star.brightness += armBrightness * 0.3f;
+			if (star.brightness > 1.0f) star.brightness = 1.0f;
+		}
 
-				while (angleDiff > M_PI) angleDiff -= 2.0f * M_PI;
-				while (angleDiff < -M_PI) angleDiff += 2.0f * M_PI;
+		stars.setStar(begin + i, star);
+	}
+}
 
-				float armDist = fabs(angleDiff * star.radius);
+void decodeStarColor(const StarField& stars, size_t index, uint8_t* rgba) {
+	const StarType& type = starTypes[stars.type[index] & ~STAR_TYPE_BULGE];
+	// the colors are 0-1 and the brightness code 0-255, so the product is the byte
+	float brightness = stars.brightness[index];
+	rgba[0] = static_cast<uint8_t>(type.r * brightness + 0.5f);
+	rgba[1] = static_cast<uint8_t>(type.g * brightness + 0.5f);
+	rgba[2] = static_cast<uint8_t>(type.b * brightness + 0.5f);
+	rgba[3] = 255;
+}
 
-				minArmDist = fmin(minArmDist, armDist);
-			}
-			float armBrightness = exp(-minArmDist * minArmDist / (config.armWidth * config.armWidth * 4.0f));
+StarFieldScale starFieldScale(const GalaxyConfig& config) {
+	StarFieldScale scale;
+	// disk stars reach out to the sampling table's maxRadius, bulge stars to bulgeRadius
+	scale.maxRadius = static_cast<float>(std::max(config.diskRadius * 2.0, config.bulgeRadius));
+	// disk heights are gaussian with sigma up to diskHeight, 8 sigma leaves out one in 10^15
+	scale.maxHeight = static_cast<float>(std::max(config.diskHeight * 8.0, config.bulgeRadius));
+	scale.rotationSpeed = static_cast<float>(config.rotationSpeed);
+	scale.bulgeRadius = static_cast<float>(config.bulgeRadius);
+	return scale;
+}
 
-			star.brightness += armBrightness * 0.3f;
-			if (star.brightness > 1.0f) star.brightness = 1.0f;
+// value in [0, 1] to the step it falls in
+static uint16_t encodeStarCode(float value) {
+	float step = std::floor(value * STAR_CODE_STEPS);
+	return static_cast<uint16_t>(std::min(std::max(step, 0.0f), STAR_CODE_STEPS - 1.0f));
+}
+
+static float starAngularVelocity(const StarFieldScale& scale, float radius, uint8_t type) {
+	// higher velocity since bulge rotates faster
+	if (type & STAR_TYPE_BULGE) {
+		return scale.rotationSpeed * 0.5f / (scale.bulgeRadius + 1.0f);
+	}
+	// outer stars rotate slower
+	return scale.rotationSpeed * 1.0f / (std::sqrt(radius / scale.bulgeRadius) * (radius + 1.0f));
+}
+
+// field versions handed out so far, shared by every field (they're resized on builder threads)
+static std::atomic<unsigned long long> starFieldVersions{ 0 };
+
+void StarField::resize(size_t count) {
+	version = ++starFieldVersions;
+
+	radius.resize(count);
+	angle.resize(count);
+	height.resize(count);
+	type.resize(count);
+	brightness.resize(count);
+}
+
+void StarField::clear() {
+	resize(0);
+}
+
+void StarField::setStar(size_t index, const Star& star) {
+	double turns = star.angle / (2.0 * M_PI);
+
+	radius[index] = encodeStarCode(star.radius / scale.maxRadius);
+	angle[index] = encodeStarCode(static_cast<float>(turns - std::floor(turns)));
+	height[index] = encodeStarCode((star.y / scale.maxHeight + 1.0f) * 0.5f);
+
+	type[index] = static_cast<uint8_t>(star.type | (star.inBulge ? STAR_TYPE_BULGE : 0));
+	brightness[index] = static_cast<uint8_t>(std::min(std::max(star.brightness, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+void StarField::append(const StarField& source, size_t first, size_t count) {
+	scale = source.scale;
+
+	radius.insert(radius.end(), source.radius.begin() + first, source.radius.begin() + first + count);
+	angle.insert(angle.end(), source.angle.begin() + first, source.angle.begin() + first + count);
+	height.insert(height.end(), source.height.begin() + first, source.height.begin() + first + count);
+	type.insert(type.end(), source.type.begin() + first, source.type.begin() + first + count);
+	brightness.insert(brightness.end(), source.brightness.begin() + first,
+		source.brightness.begin() + first + count);
+}
+
+bool starFieldCompatible(const GalaxyConfig& a, const GalaxyConfig& b) {
+	return a.numSpiralArms == b.numSpiralArms && a.spiralTightness == b.spiralTightness &&
+		a.armWidth == b.armWidth && a.diskRadius == b.diskRadius && a.bulgeRadius == b.bulgeRadius &&
+		a.diskHeight == b.diskHeight && a.bulgeHeight == b.bulgeHeight &&
+		a.armDensityBoost == b.armDensityBoost && a.seed == b.seed && a.rotationSpeed == b.rotationSpeed;
+}
+
+void generateStarField(StarField& stars, const GalaxyConfig& config, const SpiralArmField& armField,
+	const std::atomic<bool>* cancel, const StarChunkCallback& onChunk) {
+	stars.clear();
+	extendStarField(stars, config, armField, cancel, onChunk);
+}
+
+void extendStarField(StarField& stars, const GalaxyConfig& config, const SpiralArmField& armField,
+	const std::atomic<bool>* cancel, const StarChunkCallback& onChunk) {
+	const int keptStars = std::min(static_cast<int>(stars.size()), config.numStars);
+	stars.scale = starFieldScale(config);
+	stars.resize(config.numStars);
+	if (keptStars == config.numStars) return;
+
+	// the star range is split into fixed-size chunks, each seeded from (seed, chunk index),
+	// so the output is bit-identical for a given seed no matter how many threads run.
+	// it also makes the field prefix-stable: star i is the same whatever numStars is,
+	// so only the chunks past the kept stars need generating. a partly kept chunk is
+	// generated whole, its kept stars come out the same
+	const int firstChunk = keptStars / STAR_CHUNK_SIZE;
+	const int totalChunks = (config.numStars + STAR_CHUNK_SIZE - 1) / STAR_CHUNK_SIZE;
+	const int numChunks = totalChunks - firstChunk;
+
+	DiskSamplingTable table;
+	buildDiskSamplingTable(table, config, armField);
+
+	int numThreads = config.numThreads;
+	if (numThreads <= 0) {
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	numThreads = std::max(1, std::min(numThreads, numChunks));
+
+	// shuffled work order, so a partially generated field already covers the whole galaxy.
+	// the order only decides when a chunk is made, not what is in it
+	std::vector<int> chunkOrder(numChunks);
+	for (int c = 0; c < numChunks; c++) chunkOrder[c] = firstChunk + c;
+	std::mt19937 orderRng(deriveStreamSeed(config.seed, RNG_STREAM_STAR_CHUNK_ORDER, 0));
+	std::shuffle(chunkOrder.begin(), chunkOrder.end(), orderRng);
+
+	std::atomic<int> nextChunk(0);
+	auto worker = [&]() {
+		int next;
+		while ((next = nextChunk.fetch_add(1)) < numChunks) {
+			if (cancel && cancel->load(std::memory_order_relaxed)) break;
+
+			int chunk = chunkOrder[next];
+			int begin = chunk * STAR_CHUNK_SIZE;
+			int count = std::min(STAR_CHUNK_SIZE, config.numStars - begin);
+
+			std::mt19937 rng(deriveStreamSeed(config.seed, RNG_STREAM_STARS, chunk));
+			generateStarChunk(stars, begin, count, config, table, armField, rng);
+
+			if (onChunk) onChunk(begin, count);
+		}
+		};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; t++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+// below this many stars a range isn't worth handing to another thread
+const size_t STAR_POSITIONS_MIN_CHUNK = 4096;
+
+// Disk angular velocity for every radius code and one more entry for the bulge.
+// Rebuilt when a field with another scale comes along
+struct AngularVelocityTable {
+	StarFieldScale scale = {};
+	std::vector<float> velocity;
+};
+
+const float* starAngularVelocities(const StarFieldScale& scale) {
+	static AngularVelocityTable table;
+	if (table.velocity.empty() || memcmp(&table.scale, &scale, sizeof(scale)) != 0) {
+		const size_t codes = static_cast<size_t>(STAR_CODE_STEPS);
+		table.scale = scale;
+		table.velocity.resize(codes + 1);
+		for (size_t code = 0; code < codes; code++) {
+			uint16_t radiusCode = static_cast<uint16_t>(code);
+			table.velocity[code] = starAngularVelocity(scale, decodeStarRadius(scale, radiusCode), 0);
+		}
+		table.velocity[codes] = starAngularVelocity(scale, 0.0f, STAR_TYPE_BULGE);
+	}
+	return table.velocity.data();
+}
+
+// stars [first, first + count) of indices, or of the field itself without indices,
+// decoded a block at a time into the arrays the SIMD kernel takes.
+// Star i's xyz goes to positions[i * stride]
+static void computeStarPositionRange(const StarField& stars, const float* velocities, double time,
+	const uint32_t* indices, size_t first, size_t count, float* positions, size_t stride) {
+	const StarFieldScale& scale = stars.scale;
+	const size_t BLOCK = 1024;
+	float radius[BLOCK], angle[BLOCK], angularVelocity[BLOCK];
+	float x[BLOCK];
+	float z[BLOCK];
+	size_t star[BLOCK];
+
+	for (size_t blockBegin = first; blockBegin < first + count; blockBegin += BLOCK) {
+		size_t blockCount = std::min(BLOCK, first + count - blockBegin);
+		for (size_t i = 0; i < blockCount; i++) {
+			star[i] = indices ? indices[blockBegin + i] : blockBegin + i;
+		}
+		for (size_t i = 0; i < blockCount; i++) {
+			radius[i] = decodeStarRadius(scale, stars.radius[star[i]]);
+			angle[i] = decodeStarAngle(stars.angle[star[i]]);
+			angularVelocity[i] = velocities[starVelocityIndex(stars.radius[star[i]], stars.type[star[i]])];
 		}
+		computeOrbitXZ(radius, angle, angularVelocity, blockCount, time, x, z);
 
-		stars.push_back(star);
+		float* out = &positions[blockBegin * stride];
+		for (size_t i = 0; i < blockCount; i++) {
+			out[i * stride + 0] = x[i];
+			out[i * stride + 1] = decodeStarHeight(scale, stars.height[star[i]]);
+			out[i * stride + 2] = z[i];
+		}
 	}
 }
 
-void updateStarPositions(std::vector<Star>& stars, double deltaTime) {
-	for (auto& star : stars) {
-		star.angle += star.angularVelocity * deltaTime;
+void computeStarPositions(const StarField& stars, double time, float* positions) {
+	const float* velocities = starAngularVelocities(stars.scale);
+	parallelFor(g_threadPool, stars.size(), STAR_POSITIONS_MIN_CHUNK, [&](size_t begin, size_t end) {
+		computeStarPositionRange(stars, velocities, time, nullptr, begin, end - begin, positions, 3);
+		});
+}
+
+// The vertex shader decodes each star and puts it on its orbit from the arrays uploaded at
+// build time; the quantised arrays go up as they are, the shader repeats the decoding above.
+// GLSL 1.20 only has float, so angles are uploaded decoded as of an epoch near the simulation
+// time and the shader gets the time since then. Keeping that under STAR_EPOCH_SPAN holds the
+// float rounding of angularVelocity * time to a small fraction of a degree; past it the
+// angles are moved to a new epoch on the CPU and re-uploaded.
+// No fragment shader, the points still go through the fixed-function smoothing and blending.
+static const char* STAR_VERTEX_SHADER = R"(
+#version 120
+attribute float radiusCode;
+attribute float angle;
+attribute float heightCode;
+attribute float type;
+attribute float brightness;
+
+uniform float timeSinceEpoch;
+uniform float maxRadius;
+uniform float maxHeight;
+uniform float rotationSpeed;
+uniform float bulgeRadius;
+uniform vec3 typeColors[7];
+
+void main() {
+	const float CODE_STEPS = 65536.0;
+	float radius = (radiusCode + 0.5) / CODE_STEPS * maxRadius;
+	float height = ((heightCode + 0.5) / CODE_STEPS * 2.0 - 1.0) * maxHeight;
+
+	bool inBulge = type >= 128.0;
+	float angularVelocity = inBulge ? rotationSpeed * 0.5 / (bulgeRadius + 1.0)
+		: rotationSpeed / (sqrt(radius / bulgeRadius) * (radius + 1.0));
+
+	float phase = mod(angle + angularVelocity * timeSinceEpoch, 6.2831853);
+	vec4 position = vec4(radius * cos(phase), height, radius * sin(phase), 1.0);
+	gl_Position = gl_ModelViewProjectionMatrix * position;
+
+	int typeIndex = int(inBulge ? type - 128.0 : type);
+	gl_FrontColor = vec4(typeColors[typeIndex] * (brightness / 255.0), 1.0);
+}
+)";
+
+// bound in this order, so the radius array is attribute 0 and stands in for gl_Vertex
+static const char* const STAR_ATTRIBUTES[] = { "radiusCode", "angle", "heightCode", "type", "brightness" };
+const int STAR_ATTRIBUTE_COUNT = 5;
+
+// simulation seconds the shader's float time may run from the epoch
+const double STAR_EPOCH_SPAN = 1024.0;
+
+// One buffer holds the arrays back to back, each sized for capacity stars,
+// so appending stars writes to the end of each of them.
+// The index's order goes in an element buffer, the visible bins are drawn from that.
+struct StarBuffer {
+	bool initialized = false;	// program creation tried
+	GLuint program = 0;			// 0 = no shaders, draw on the CPU
+	GLint timeSinceEpochLocation = -1;
+	GLint scaleLocations[4] = { -1, -1, -1, -1 };	// the StarFieldScale members in order
+
+	GLuint buffer = 0;
+	size_t capacity = 0;
+	size_t count = 0;					// stars uploaded
+	unsigned long long version = 0;		// of the field they came from
+	double epoch = 0.0;					// the uploaded angles are at this time
+
+	GLuint elementBuffer = 0;
+	size_t elementCount = 0;
+	std::vector<unsigned long long> annulusStamps;	// of the spans of order uploaded
+};
+
+static StarBuffer starBuffer;
+
+// shared by the render paths, and what of it is in view this frame
+static StarIndex starIndex;
+static std::vector<StarRange> visibleStars;
+static std::vector<StarClusterRef> visibleClusters;
+static bool starCulling = true;
+static bool starLevelOfDetail = true;
+
+// how each array of the buffer is stored, the angles are the only ones decoded for upload
+static const GLenum STAR_BUFFER_TYPES[STAR_ATTRIBUTE_COUNT] = {
+	GL_UNSIGNED_SHORT, GL_FLOAT, GL_UNSIGNED_SHORT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE
+};
+static const size_t STAR_BUFFER_SIZES[STAR_ATTRIBUTE_COUNT] = {
+	sizeof(uint16_t), sizeof(float), sizeof(uint16_t), sizeof(uint8_t), sizeof(uint8_t)
+};
+
+static GLintptr starArrayOffset(const StarBuffer& buffer, int array, size_t firstStar) {
+	size_t bytes = 0;
+	for (int a = 0; a < array; a++) {
+		// every array starts 4-byte aligned
+		bytes += (buffer.capacity * STAR_BUFFER_SIZES[a] + 3) & ~static_cast<size_t>(3);
+	}
+	return static_cast<GLintptr>(bytes + firstStar * STAR_BUFFER_SIZES[array]);
+}
+
+static void uploadStarArray(const StarBuffer& buffer, int array, size_t first, size_t count, const void* data) {
+	glBufferSubData(GL_ARRAY_BUFFER, starArrayOffset(buffer, array, first),
+		static_cast<GLsizeiptr>(count * STAR_BUFFER_SIZES[array]), data);
+}
+
+// angles of stars [first, first + count) at the buffer's epoch
+static void uploadStarAngles(const StarBuffer& buffer, const StarField& stars, size_t first, size_t count) {
+	static std::vector<float> angles;
+	angles.resize(count);
+
+	const float* velocities = starAngularVelocities(stars.scale);
+	parallelFor(g_threadPool, count, STAR_POSITIONS_MIN_CHUNK, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			size_t star = first + i;
+			float angularVelocity = velocities[starVelocityIndex(stars.radius[star], stars.type[star])];
+			angles[i] = rotationAngleAt(decodeStarAngle(stars.angle[star]), angularVelocity, buffer.epoch);
+		}
+		});
+
+	uploadStarArray(buffer, 1, first, count, angles.data());
+}
+
+// stars [first, size) of the field, the buffer must already hold the ones before
+static void uploadStars(StarBuffer& buffer, const StarField& stars, size_t first) {
+	size_t count = stars.size() - first;
+
+	uploadStarArray(buffer, 0, first, count, &stars.radius[first]);
+	uploadStarAngles(buffer, stars, first, count);
+	uploadStarArray(buffer, 2, first, count, &stars.height[first]);
+	uploadStarArray(buffer, 3, first, count, &stars.type[first]);
+	uploadStarArray(buffer, 4, first, count, &stars.brightness[first]);
+
+	buffer.count = stars.size();
+}
+
+// brings the buffer up to date with the field, bound to GL_ARRAY_BUFFER
+static void syncStarBuffer(StarBuffer& buffer, const StarField& stars, double time) {
+	if (!buffer.buffer) glGenBuffers(1, &buffer.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer.buffer);
+
+	bool replaced = stars.version != buffer.version || stars.size() < buffer.count;
+	if (!replaced && stars.size() == buffer.count) {
+		if (std::abs(time - buffer.epoch) > STAR_EPOCH_SPAN) {
+			buffer.epoch = time;
+			uploadStarAngles(buffer, stars, 0, buffer.count);
+		}
+		return;
+	}
+
+	// a preview grows by many small appends, so room is made for twice what is there
+	size_t first = replaced ? 0 : buffer.count;
+	if (stars.size() > buffer.capacity) {
+		buffer.capacity = replaced ? stars.size() : std::max(stars.size(), buffer.capacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, starArrayOffset(buffer, STAR_ATTRIBUTE_COUNT - 1, buffer.capacity),
+			nullptr, GL_STATIC_DRAW);
+		first = 0;
+	}
+
+	// appended stars have to share the epoch of the ones already there
+	if (first == 0) buffer.epoch = time;
+	uploadStars(buffer, stars, first);
+	buffer.version = stars.version;
+}
+
+static void createStarProgram(StarBuffer& buffer) {
+	buffer.program = createShaderProgram(STAR_VERTEX_SHADER, nullptr, STAR_ATTRIBUTES, STAR_ATTRIBUTE_COUNT);
+	if (!buffer.program) return;
+
+	buffer.timeSinceEpochLocation = glGetUniformLocation(buffer.program, "timeSinceEpoch");
+	const char* scaleNames[4] = { "maxRadius", "maxHeight", "rotationSpeed", "bulgeRadius" };
+	for (int i = 0; i < 4; i++) {
+		buffer.scaleLocations[i] = glGetUniformLocation(buffer.program, scaleNames[i]);
+	}
+
+	// the palette never changes, it stays with the program
+	float typeColors[NUM_STAR_TYPES * 3];
+	for (int t = 0; t < NUM_STAR_TYPES; t++) {
+		typeColors[t * 3 + 0] = starTypes[t].r;
+		typeColors[t * 3 + 1] = starTypes[t].g;
+		typeColors[t * 3 + 2] = starTypes[t].b;
+	}
+	glUseProgram(buffer.program);
+	glUniform3fv(glGetUniformLocation(buffer.program, "typeColors"), NUM_STAR_TYPES, typeColors);
+	glUseProgram(0);
+}
+
+// brings the element buffer up to date with the index's order, bound to GL_ELEMENT_ARRAY_BUFFER.
+// Only the annuli binned again since the last frame are sent
+static void syncStarElements(StarBuffer& buffer, const StarIndex& index) {
+	if (!buffer.elementBuffer) glGenBuffers(1, &buffer.elementBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.elementBuffer);
+
+	if (index.order.size() != buffer.elementCount) {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(index.order.size() * sizeof(uint32_t)),
+			index.order.data(), GL_STATIC_DRAW);
+		buffer.elementCount = index.order.size();
+		buffer.annulusStamps.clear();
+		for (const StarAnnulus& annulus : index.annuli) buffer.annulusStamps.push_back(annulus.stamp);
+		return;
+	}
+
+	buffer.annulusStamps.resize(index.annuli.size(), 0);
+	for (size_t a = 0; a < index.annuli.size(); a++) {
+		const StarAnnulus& annulus = index.annuli[a];
+		if (buffer.annulusStamps[a] == annulus.stamp) continue;
+
+		buffer.annulusStamps[a] = annulus.stamp;
+		if (annulus.count == 0) continue;
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(annulus.first * sizeof(uint32_t)),
+			static_cast<GLsizeiptr>(annulus.count * sizeof(uint32_t)), &index.order[annulus.first]);
+	}
+}
+
+// The streamed path: only the stars in view are written each frame, packed one after
+// another as xyz and an rgba colour, so one glDrawArrays takes them whatever bins they are from.
+// Colours are decoded along with the positions, it costs less than keeping a buffer of them
+// in index order up to date as annuli are binned again.
+// Clusters drawn in place of their stars are packed the same way, after the stars;
+// the shader path streams those alone.
+const size_t STREAMED_STAR_FLOATS = 4;
+
+struct StreamedStars {
+	StreamBuffer vertices;
+	std::vector<float> clientVertices;	// without buffer objects
+	std::vector<size_t> rangeStart;		// packed vertices before each visible range
+};
+
+static StreamedStars streamedStars;
 
-		// normalize angle to [0, 2*PI]
-		while (star.angle > 2.0f * M_PI) star.angle -= 2.0f * M_PI;
-		while (star.angle < 0.0f) star.angle += 2.0f * M_PI;
+static StarRenderPath requestedStarRenderPath = STAR_RENDER_SHADER;
 
-		// recalc X and Z based on new angle
-		float oldY = star.y;
-		star.x = star.radius * cos(star.angle);
-		star.z = star.radius * sin(star.angle);
-		star.y = oldY;
+// rgba of stars [first, first + count) of indices into the fourth float of each packed vertex
+static void packStarColors(const StarField& stars, const uint32_t* indices, size_t first, size_t count,
+	float* vertices) {
+	for (size_t i = first; i < first + count; i++) {
+		uint8_t color[4];
+		decodeStarColor(stars, indices[i], color);
+		memcpy(&vertices[i * STREAMED_STAR_FLOATS + 3], color, sizeof(color));
 	}
 }
 
-void renderStars(const std::vector<Star>& stars, const RenderZone& zone) {
+// where each visible range starts among the packed vertices, returns how many there are in all
+static size_t countVisibleStars(StreamedStars& streamed, const std::vector<StarRange>& ranges) {
+	streamed.rangeStart.resize(ranges.size());
+	size_t count = 0;
+	for (size_t r = 0; r < ranges.size(); r++) {
+		streamed.rangeStart[r] = count;
+		count += ranges[r].count;
+	}
+	return count;
+}
+
+static void packVisibleStars(const StreamedStars& streamed, const StarField& stars, const StarIndex& index,
+	const std::vector<StarRange>& ranges, size_t count, double time, float* vertices) {
+	const float* velocities = starAngularVelocities(stars.scale);
+	const std::vector<size_t>& rangeStart = streamed.rangeStart;
+
+	parallelFor(g_threadPool, count, STAR_POSITIONS_MIN_CHUNK, [&](size_t begin, size_t end) {
+		// the chunk may span several ranges, each is a run of order
+		size_t r = std::upper_bound(rangeStart.begin(), rangeStart.end(), begin) - rangeStart.begin() - 1;
+		while (begin < end) {
+			size_t runEnd = std::min(end, rangeStart[r] + ranges[r].count);
+			// indexed by packed vertex, so vertex i is star indices[i]
+			const uint32_t* indices = &index.order[ranges[r].first] - rangeStart[r];
+
+			computeStarPositionRange(stars, velocities, time, indices, begin, runEnd - begin,
+				vertices, STREAMED_STAR_FLOATS);
+			packStarColors(stars, indices, begin, runEnd - begin, vertices);
+
+			begin = runEnd;
+			r++;
+		}
+		});
+}
+
+// clusters' mean orbits are evaluated like stars', with the same kernel
+static void packStarClusters(const StarIndex& index, const std::vector<StarClusterRef>& clusters, double time,
+	float* vertices) {
+	parallelFor(g_threadPool, clusters.size(), STAR_POSITIONS_MIN_CHUNK, [&](size_t begin, size_t end) {
+		const size_t BLOCK = 1024;
+		float radius[BLOCK], angle[BLOCK], angularVelocity[BLOCK];
+		float x[BLOCK];
+		float z[BLOCK];
+
+		for (size_t blockBegin = begin; blockBegin < end; blockBegin += BLOCK) {
+			size_t count = std::min(BLOCK, end - blockBegin);
+			for (size_t i = 0; i < count; i++) {
+				const StarClusterRef& ref = clusters[blockBegin + i];
+				const StarCluster& cluster = index.annuli[ref.annulus].clusters[ref.cluster];
+				radius[i] = cluster.radius;
+				angle[i] = cluster.angle;
+				angularVelocity[i] = cluster.angularVelocity;
+			}
+			computeOrbitXZ(radius, angle, angularVelocity, count, time, x, z);
+
+			float* out = &vertices[blockBegin * STREAMED_STAR_FLOATS];
+			for (size_t i = 0; i < count; i++) {
+				const StarClusterRef& ref = clusters[blockBegin + i];
+				const StarCluster& cluster = index.annuli[ref.annulus].clusters[ref.cluster];
+				out[i * STREAMED_STAR_FLOATS + 0] = x[i];
+				out[i * STREAMED_STAR_FLOATS + 1] = cluster.height;
+				out[i * STREAMED_STAR_FLOATS + 2] = z[i];
+				memcpy(&out[i * STREAMED_STAR_FLOATS + 3], cluster.color, sizeof(cluster.color));
+			}
+		}
+		});
+}
+
+static void drawPackedStars(const char* vertices, size_t count) {
+	const GLsizei stride = static_cast<GLsizei>(STREAMED_STAR_FLOATS * sizeof(float));
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	glVertexPointer(3, GL_FLOAT, stride, vertices);
+	glColorPointer(4, GL_UNSIGNED_BYTE, stride, vertices + 3 * sizeof(float));
+	glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+}
+
+static void packStarsInView(const StarField& stars, size_t starCount, double time, float* vertices) {
+	StreamedStars& streamed = streamedStars;
+	if (starCount) packVisibleStars(streamed, stars, starIndex, visibleStars, starCount, time, vertices);
+	packStarClusters(starIndex, visibleClusters, time, &vertices[starCount * STREAMED_STAR_FLOATS]);
+}
+
+// the visible clusters, and the visible stars too unless the shader draws them
+static void renderStarsStreamed(const StarField& stars, double time, bool withStars) {
+	StreamedStars& streamed = streamedStars;
+	size_t starCount = withStars ? countVisibleStars(streamed, visibleStars) : 0;
+	size_t count = starCount + visibleClusters.size();
+	if (count == 0) return;
+
+	// without buffer objects at all, everything goes from client memory every frame
+	if (!glExtensionsLoaded()) {
+		streamed.clientVertices.resize(count * STREAMED_STAR_FLOATS);
+		packStarsInView(stars, starCount, time, streamed.clientVertices.data());
+		drawPackedStars(reinterpret_cast<const char*>(streamed.clientVertices.data()), count);
+		return;
+	}
+
+	// the orbit kernel writes straight into the mapped buffer
+	size_t bytes = count * STREAMED_STAR_FLOATS * sizeof(float);
+	float* vertices = static_cast<float*>(beginStreamFrame(streamed.vertices, bytes));
+	packStarsInView(stars, starCount, time, vertices);
+	size_t offset = endStreamFrame(streamed.vertices, bytes);
+
+	drawPackedStars(reinterpret_cast<const char*>(offset), count);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	fenceStreamFrame(streamed.vertices);
+}
+
+// compiles the star shader on first use
+static void initStarRenderer() {
+	StarBuffer& buffer = starBuffer;
+	if (buffer.initialized) return;
+
+	buffer.initialized = true;
+	createStarProgram(buffer);
+	if (!buffer.program) {
+		std::cout << "Star shader unavailable, animating stars on the CPU" << std::endl;
+	}
+}
+
+static StarRenderPath activeStarRenderPath() {
+	initStarRenderer();
+	return starBuffer.program ? requestedStarRenderPath : STAR_RENDER_STREAMED;
+}
+
+void setStarRenderPath(StarRenderPath path) {
+	requestedStarRenderPath = path;
+}
+
+void setStarCulling(bool enabled) {
+	starCulling = enabled;
+}
+
+void setStarLevelOfDetail(bool enabled) {
+	starLevelOfDetail = enabled;
+}
+
+const char* starRendererName() {
+	if (activeStarRenderPath() == STAR_RENDER_SHADER) return "vertex shader";
+	if (!glExtensionsLoaded()) return "client arrays";
+	return glBufferStorageSupported() ? "streamed, persistently mapped" : "streamed, glBufferSubData";
+}
+
+void renderStars(const StarField& stars, double time, const RenderZone& zone) {
+	if (stars.empty()) return;
+
 	glPointSize(2.0f);
-	glBegin(GL_POINTS);
 
-	for (const auto& star : stars) {
-		glColor3f(star.r * star.brightness,
-		          star.g * star.brightness,
-		          star.b * star.brightness);
-		glVertex3f(star.x, star.y, star.z);
+	updateStarIndex(starIndex, stars, time);
+	visibleClusters.clear();
+	if (starCulling) {
+		findVisibleStars(starIndex, currentViewFrustum(), time, visibleStars,
+			starLevelOfDetail ? &visibleClusters : nullptr);
+	} else {
+		visibleStars.assign(1, StarRange{ 0, static_cast<uint32_t>(stars.size()) });
 	}
 
-	glEnd();
+	if (activeStarRenderPath() == STAR_RENDER_STREAMED) {
+		renderStarsStreamed(stars, time, true);
+		return;
+	}
+
+	StarBuffer& buffer = starBuffer;
+	syncStarBuffer(buffer, stars, time);
+
+	const StarFieldScale& scale = stars.scale;
+	glUseProgram(buffer.program);
+	glUniform1f(buffer.timeSinceEpochLocation, static_cast<float>(time - buffer.epoch));
+	glUniform1f(buffer.scaleLocations[0], scale.maxRadius);
+	glUniform1f(buffer.scaleLocations[1], scale.maxHeight);
+	glUniform1f(buffer.scaleLocations[2], scale.rotationSpeed);
+	glUniform1f(buffer.scaleLocations[3], scale.bulgeRadius);
+
+	// the codes go in as plain numbers, not normalised, the shader scales them itself
+	for (int a = 0; a < STAR_ATTRIBUTE_COUNT; a++) {
+		glEnableVertexAttribArray(a);
+		glVertexAttribPointer(a, 1, STAR_BUFFER_TYPES[a], GL_FALSE, 0,
+			reinterpret_cast<const void*>(starArrayOffset(buffer, a, 0)));
+	}
+
+	// each visible range is a run of the element buffer
+	syncStarElements(buffer, starIndex);
+	static std::vector<GLsizei> counts;
+	static std::vector<const void*> offsets;
+	counts.clear();
+	offsets.clear();
+	for (const StarRange& range : visibleStars) {
+		counts.push_back(static_cast<GLsizei>(range.count));
+		offsets.push_back(reinterpret_cast<const void*>(range.first * sizeof(uint32_t)));
+	}
+	if (!counts.empty()) {
+		glMultiDrawElements(GL_POINTS, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+			static_cast<GLsizei>(counts.size()));
+	}
+
+	for (int a = 0; a < STAR_ATTRIBUTE_COUNT; a++) {
+		glDisableVertexAttribArray(a);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+
+	renderStarsStreamed(stars, time, false);
+}
+
+void releaseStarRenderer() {
+	StarBuffer& buffer = starBuffer;
+	if (buffer.buffer) glDeleteBuffers(1, &buffer.buffer);
+	if (buffer.elementBuffer) glDeleteBuffers(1, &buffer.elementBuffer);
+	if (buffer.program) glDeleteProgram(buffer.program);
+	buffer = StarBuffer();
+
+	StreamedStars& streamed = streamedStars;
+	releaseStreamBuffer(streamed.vertices);
+	streamed = StreamedStars();
+
+	starIndex = StarIndex();
 }
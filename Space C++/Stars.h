@@ -1,12 +1,19 @@
 #pragma once
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
 
 struct RenderZone;
+struct SpiralArmField;
 
+// One star as the generator makes it, StarField stores them quantised
 struct Star {
 	float x, y, z;
-	float r, g, b;
+	int type;				// index into the spectral types, O to M
 	float brightness;
+	bool inBulge;
 
 	// For rotation animation
 	float radius;			// Distance from galactic center
@@ -14,6 +21,58 @@ struct Star {
 	float angularVelocity;  // Rotation speed (radians per second)
 };
 
+const int NUM_STAR_TYPES = 7;
+// set in StarField::type for bulge stars, which all orbit at the same angular velocity
+const uint8_t STAR_TYPE_BULGE = 0x80;
+
+// What a quantised star is relative to, fixed by the galaxy config
+struct StarFieldScale {
+	float maxRadius;		// radius covers [0, maxRadius]
+	float maxHeight;		// height covers [-maxHeight, maxHeight], stars past it are clamped
+	float rotationSpeed;	// angular velocity is worked out from the radius with these
+	float bulgeRadius;
+};
+
+// 16-bit codes step in 1/65536 of the range and decode to the middle of their step
+const float STAR_CODE_STEPS = 65536.0f;
+
+// Stars as quantised structure-of-arrays, 8 bytes each. Colour is always a spectral type
+// scaled by brightness, and angular velocity follows from the radius, so neither is stored.
+// A decoded star is off from where the generator put it by at most half a step in
+// each of radius, height and angle:
+//   maxRadius / 131072 radially, maxHeight / 65536 vertically, radius * PI / 65536 along the orbit,
+// so at most 0.012, 0.006 and 0.077 for the default galaxy, whose stars reach radius 1600.
+// Its angular velocity is that of its decoded radius, so it keeps to the rotation curve exactly
+// and only that bound separates it from where the generator's star would be at time 0;
+// later on they drift apart along the orbit, as the two radii rotate at slightly different rates.
+//
+// The field holds each orbit at time 0 and is never written while the galaxy animates:
+// positions are evaluated from the simulation time when drawing, on the GPU from arrays
+// uploaded once, or on the CPU where shaders aren't available. Both decode as they go.
+struct StarField {
+	std::vector<uint16_t> radius;		// distance from galactic center
+	std::vector<uint16_t> angle;		// angle in the XZ plane at time 0
+	std::vector<uint16_t> height;		// y, constant along the orbit
+	std::vector<uint8_t> type;			// spectral type, | STAR_TYPE_BULGE for bulge stars
+	std::vector<uint8_t> brightness;	// 0-255 for 0-1
+
+	StarFieldScale scale = {};
+
+	// changes whenever resize or clear may have replaced stars, append keeps it.
+	// numbers are never reused, so a field swapped in for another never looks unchanged
+	unsigned long long version = 0;
+
+	size_t size() const { return radius.size(); }
+	bool empty() const { return radius.empty(); }
+
+	// any star past the old size is left for setStar to fill
+	void resize(size_t count);
+	void clear();
+	void setStar(size_t index, const Star& star);
+	// appends stars [first, first + count) of source, which sets the scale
+	void append(const StarField& source, size_t first, size_t count);
+};
+
 struct GalaxyConfig {
 	int numStars;
 	int numSpiralArms;
@@ -27,8 +86,85 @@ struct GalaxyConfig {
 	unsigned int seed;
 
 	double rotationSpeed;	// Base rotation multiplier
+
+	int numThreads;			// generation threads, 0 = one per core
+};
+
+// stars are generated in chunks of this size, each from its own random stream
+const int STAR_CHUNK_SIZE = 16384;
+
+// Called from the generator threads each time a chunk of stars is finished
+using StarChunkCallback = std::function<void(int firstStar, int count)>;
+
+// cancel is polled between chunks; a cancelled field is left incomplete.
+// Chunks are generated in a shuffled order, so the finished ones handed to onChunk
+// are spread evenly over the star range.
+void generateStarField(StarField& stars, const GalaxyConfig& config, const SpiralArmField& armField,
+	const std::atomic<bool>* cancel = nullptr, const StarChunkCallback& onChunk = nullptr);
+
+// Like generateStarField, but keeps the stars already in the field (dropping any past numStars)
+// and only generates the rest. They have to come from a compatible config.
+void extendStarField(StarField& stars, const GalaxyConfig& config, const SpiralArmField& armField,
+	const std::atomic<bool>* cancel = nullptr, const StarChunkCallback& onChunk = nullptr);
+
+// the quantisation ranges generated fields use for this config
+StarFieldScale starFieldScale(const GalaxyConfig& config);
+// true if the two configs produce the same stars apart from how many there are
+bool starFieldCompatible(const GalaxyConfig& a, const GalaxyConfig& b);
+// xyz per star at the given simulation time, positions has room for 3 floats per star
+void computeStarPositions(const StarField& stars, double time, float* positions);
+
+inline float decodeStarCode(uint16_t code) {
+	return (code + 0.5f) * (1.0f / STAR_CODE_STEPS);
+}
+
+inline float decodeStarRadius(const StarFieldScale& scale, uint16_t code) {
+	return decodeStarCode(code) * scale.maxRadius;
+}
+
+inline float decodeStarAngle(uint16_t code) {
+	return decodeStarCode(code) * 6.2831853f;
+}
+
+inline float decodeStarHeight(const StarFieldScale& scale, uint16_t code) {
+	return (decodeStarCode(code) * 2.0f - 1.0f) * scale.maxHeight;
+}
+
+// the colour a star is drawn with, opaque rgba
+void decodeStarColor(const StarField& stars, size_t index, uint8_t* rgba);
+
+// Disk angular velocity for every radius code, then one entry for the bulge, so decoding
+// a star costs a lookup instead of a square root and a division. Index it with starVelocityIndex
+const float* starAngularVelocities(const StarFieldScale& scale);
+
+// the radius code for disk stars, the last entry for bulge stars. Worked out with a mask:
+// bulge stars are mixed in at random, so a branch here would mispredict all the time
+inline size_t starVelocityIndex(uint16_t radiusCode, uint8_t type) {
+	size_t bulge = type >> 7;
+	return (radiusCode & (bulge - 1)) | (bulge << 16);
+}
+
+enum StarRenderPath {
+	// the field sits in a static buffer, a vertex shader rotates it from a time uniform
+	STAR_RENDER_SHADER,
+	// the stars in view are put on their orbits on the CPU every frame and streamed through
+	// a persistently mapped buffer (glBufferSubData without ARB_buffer_storage,
+	// client arrays without OpenGL 2.0)
+	STAR_RENDER_STREAMED,
 };
 
-void generateStarField(std::vector<Star>& stars, const GalaxyConfig& config);
-void updateStarPositions(std::vector<Star>& stars, double deltaTime);
-void renderStars(const std::vector<Star>& stars, const RenderZone& zone);
+// The shader path is used unless it is unavailable or another one was asked for.
+// Either way the stars are culled against the GL view first, a StarIndex bin at a time,
+// and where a cluster of them would cover less than a pixel one point stands in for it,
+// so what a frame costs follows what is in view rather than the whole field.
+void renderStars(const StarField& stars, double time, const RenderZone& zone);
+// for comparing the paths, falls back to streaming if the shader can't be used
+void setStarRenderPath(StarRenderPath path);
+// for comparing, with culling off every star is drawn (in the same order)
+void setStarCulling(bool enabled);
+// for comparing, with it off no clusters stand in for stars that are far away
+void setStarLevelOfDetail(bool enabled);
+// what renderStars will do, needs the GL context
+const char* starRendererName();
+// frees the GL buffers and program, needs the context still current
+void releaseStarRenderer();
@@ -0,0 +1,109 @@
+#include "StreamBuffer.h"
+#include <algorithm>
+
+// how long one glClientWaitSync call may block, in nanoseconds; it is called again until done
+const GLuint64 STREAM_FENCE_TIMEOUT = 1000000;
+
+// blocks until the GPU is done with the region's last frame
+static void waitForRegion(StreamBuffer& stream, int region) {
+	GLsync& fence = stream.fences[region];
+	if (!fence) return;
+
+	// the first wait flushes, so the fence is sure to reach the GPU
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while (true) {
+		GLenum result = glClientWaitSync(fence, flags, STREAM_FENCE_TIMEOUT);
+		if (result != GL_TIMEOUT_EXPIRED) break;
+		flags = 0;
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+static void deleteStreamStorage(StreamBuffer& stream) {
+	for (int r = 0; r < STREAM_BUFFER_REGIONS; r++) {
+		if (stream.fences[r]) glDeleteSync(stream.fences[r]);
+		stream.fences[r] = nullptr;
+	}
+
+	if (stream.mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		stream.mapped = nullptr;
+	}
+	if (stream.buffer) glDeleteBuffers(1, &stream.buffer);
+	stream.buffer = 0;
+}
+
+static void createStreamStorage(StreamBuffer& stream, size_t regionSize) {
+	// immutable storage can't grow, the old buffer goes once nothing draws from it
+	for (int r = 0; r < STREAM_BUFFER_REGIONS; r++) {
+		waitForRegion(stream, r);
+	}
+	deleteStreamStorage(stream);
+
+	stream.regionSize = regionSize;
+	stream.region = 0;
+
+	glGenBuffers(1, &stream.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+
+	if (stream.persistent) {
+		GLsizeiptr size = static_cast<GLsizeiptr>(regionSize * STREAM_BUFFER_REGIONS);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+		stream.mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+
+		if (!stream.mapped) {
+			// storage is immutable, so falling back needs a buffer of its own
+			stream.persistent = false;
+			glDeleteBuffers(1, &stream.buffer);
+			glGenBuffers(1, &stream.buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+		}
+	}
+}
+
+void* beginStreamFrame(StreamBuffer& stream, size_t bytes) {
+	if (!stream.buffer) {
+		stream.persistent = glBufferStorageSupported();
+	}
+	if (!stream.buffer || bytes > stream.regionSize) {
+		// a field that keeps growing, like a build preview, shouldn't reallocate every frame
+		createStreamStorage(stream, std::max(bytes, stream.regionSize + stream.regionSize / 2));
+	}
+
+	if (!stream.persistent) {
+		stream.staging.resize(bytes);
+		return stream.staging.data();
+	}
+
+	waitForRegion(stream, stream.region);
+	return stream.mapped + stream.region * stream.regionSize;
+}
+
+size_t endStreamFrame(StreamBuffer& stream, size_t bytes) {
+	glBindBuffer(GL_ARRAY_BUFFER, stream.buffer);
+
+	// coherent mapping, the writes are already visible
+	if (stream.persistent) return stream.region * stream.regionSize;
+
+	// orphaning first lets the driver hand out new storage instead of waiting
+	// for the draws still reading the last frame
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(stream.regionSize), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bytes), stream.staging.data());
+	return 0;
+}
+
+void fenceStreamFrame(StreamBuffer& stream) {
+	if (!stream.persistent) return;
+
+	stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	stream.region = (stream.region + 1) % STREAM_BUFFER_REGIONS;
+}
+
+void releaseStreamBuffer(StreamBuffer& stream) {
+	deleteStreamStorage(stream);
+	stream = StreamBuffer();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "GLExtensions.h"
+#include <vector>
+
+// regions of a stream buffer, one written by the CPU while the GPU may still read the others
+const int STREAM_BUFFER_REGIONS = 3;
+
+// A vertex buffer for data that is rewritten every frame.
+// With buffer storage the whole buffer stays mapped and the frames go round its regions,
+// each fenced after its draws so it is only written again once the GPU is done with it.
+// Without it every frame is written to a staging copy and sent with glBufferSubData
+// into freshly orphaned storage, which the driver double-buffers on its own.
+//
+// Per frame: beginStreamFrame, write, endStreamFrame, draw from the returned offset,
+// then fenceStreamFrame once the draws that read it are issued.
+struct StreamBuffer {
+	GLuint buffer = 0;
+	size_t regionSize = 0;				// bytes per frame the buffer has room for
+	int region = 0;						// the one the current frame goes to
+	bool persistent = false;
+
+	unsigned char* mapped = nullptr;	// all regions, while persistent
+	GLsync fences[STREAM_BUFFER_REGIONS] = {};
+
+	std::vector<unsigned char> staging;	// the frame, without buffer storage
+};
+
+// Returns where to write a frame of up to bytes bytes, growing the buffer if needed.
+// May wait for the GPU to finish the draws made from this region three frames ago.
+void* beginStreamFrame(StreamBuffer& stream, size_t bytes);
+
+// Makes the frame visible to draws and leaves the buffer bound to GL_ARRAY_BUFFER.
+// Returns the frame's offset in the buffer, for the gl*Pointer calls.
+size_t endStreamFrame(StreamBuffer& stream, size_t bytes);
+
+// Call after the draws reading the frame, so the region isn't overwritten under them
+void fenceStreamFrame(StreamBuffer& stream);
+
+void releaseStreamBuffer(StreamBuffer& stream);
@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool g_threadPool;
+
+// ranges per thread, so a thread that gets descheduled doesn't hold up the whole loop
+const size_t CHUNKS_PER_THREAD = 4;
+
+static void runChunks(ParallelForJob& job) {
+	size_t chunk;
+	while ((chunk = job.nextChunk.fetch_add(1)) < job.numChunks) {
+		size_t begin = chunk * job.chunkSize;
+		size_t end = std::min(begin + job.chunkSize, job.count);
+		(*job.body)(begin, end);
+	}
+}
+
+// called with the pool mutex held, once every chunk of the job has been claimed
+static void retireJob(ThreadPool& pool, ParallelForJob& job) {
+	auto it = std::find(pool.jobs.begin(), pool.jobs.end(), &job);
+	if (it != pool.jobs.end()) pool.jobs.erase(it);
+
+	job.activeThreads--;
+	if (job.activeThreads == 0) pool.jobDone.notify_all();
+}
+
+static void workerLoop(ThreadPool& pool) {
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	while (true) {
+		pool.wake.wait(lock, [&pool]() { return pool.stopping || !pool.jobs.empty(); });
+		if (pool.stopping) return;
+
+		ParallelForJob& job = *pool.jobs.front();
+		job.activeThreads++;
+
+		lock.unlock();
+		runChunks(job);
+		lock.lock();
+
+		retireJob(pool, job);
+	}
+}
+
+void startThreadPool(ThreadPool& pool, int numThreads) {
+	if (numThreads <= 0) {
+		numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	}
+
+	// the thread calling parallelFor is one of them
+	for (int t = 1; t < numThreads; t++) {
+		pool.workers.emplace_back(workerLoop, std::ref(pool));
+	}
+}
+
+void stopThreadPool(ThreadPool& pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.stopping = true;
+	}
+	pool.wake.notify_all();
+
+	for (auto& worker : pool.workers) {
+		worker.join();
+	}
+	pool.workers.clear();
+	pool.stopping = false;
+}
+
+int threadPoolSize(const ThreadPool& pool) {
+	return static_cast<int>(pool.workers.size()) + 1;
+}
+
+void parallelFor(ThreadPool& pool, size_t count, size_t minChunkSize, const ParallelForBody& body) {
+	if (count == 0) return;
+
+	const size_t numThreads = threadPoolSize(pool);
+	if (numThreads == 1 || count <= minChunkSize) {
+		body(0, count);
+		return;
+	}
+
+	size_t chunkSize = std::max(minChunkSize, count / (numThreads * CHUNKS_PER_THREAD));
+	chunkSize = (chunkSize + PARALLEL_FOR_ALIGNMENT - 1) / PARALLEL_FOR_ALIGNMENT * PARALLEL_FOR_ALIGNMENT;
+
+	ParallelForJob job;
+	job.body = &body;
+	job.count = count;
+	job.chunkSize = chunkSize;
+	job.numChunks = (count + chunkSize - 1) / chunkSize;
+	job.activeThreads = 1;
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.jobs.push_back(&job);
+	}
+	pool.wake.notify_all();
+
+	runChunks(job);
+
+	// every chunk is claimed now; wait for the workers still running one to let go,
+	// after that nothing refers to the job and it can leave the stack
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	retireJob(pool, job);
+	pool.jobDone.wait(lock, [&job]() { return job.activeThreads == 0; });
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Ranges handed to a parallelFor body start on multiples of this many elements,
+// so with 4-byte elements two threads never write the same 64-byte cache line
+const size_t PARALLEL_FOR_ALIGNMENT = 16;
+
+using ParallelForBody = std::function<void(size_t begin, size_t end)>;
+
+struct ParallelForJob {
+	const ParallelForBody* body;
+	size_t count;
+	size_t chunkSize;
+	size_t numChunks;
+	std::atomic<size_t> nextChunk{ 0 };
+	int activeThreads = 0;	// threads that may still touch the job, guarded by the pool mutex
+};
+
+// Worker threads that live as long as the program, so per-frame loops can be
+// spread over the cores without creating threads every frame.
+// Any thread may call parallelFor, also several at once; the caller works on its own job too.
+struct ThreadPool {
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;		// a job was queued or the pool is stopping
+	std::condition_variable jobDone;	// a thread let go of a job
+	std::deque<ParallelForJob*> jobs;
+	bool stopping = false;
+};
+
+extern ThreadPool g_threadPool;
+
+// numThreads counts the calling thread, 0 = one per core
+void startThreadPool(ThreadPool& pool, int numThreads = 0);
+void stopThreadPool(ThreadPool& pool);
+
+int threadPoolSize(const ThreadPool& pool);
+
+// Calls body over [0, count) in ranges of at least minChunkSize elements and returns when
+// all of them are done. Small loops, and any loop on a pool that isn't started, run inline.
+void parallelFor(ThreadPool& pool, size_t count, size_t minChunkSize, const ParallelForBody& body);
@@ -166,6 +166,7 @@ void applyUIChangesToConfigs(const UIState& uiState, GalaxyConfig& galaxyConfig,
 	gasConfig.enableDensityWaves = uiState.tempEnableDensityWaves;
 	blackHoleConfig.enableSupermassive = uiState.tempEnableSupermassive;
 	g_currentBlackHoleMass = uiState.tempBlackHoleMass;
+	blackHoleConfig.supermassiveMass = uiState.tempBlackHoleMass;
 	g_currentSolarSystemScale = uiState.tempSolarSystemScale;
 	g_currentTimeSpeed = uiState.tempTimeSpeed;
 }
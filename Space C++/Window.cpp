@@ -1,5 +1,5 @@
 #include "Window.h"
-#include <GLFW/glfw3.h>
+#include "GLExtensions.h"
 #include <iostream>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
@@ -31,6 +31,10 @@ GLFWwindow* initWindow(const WindowConfig& config) {
 }
 
 void setupOpenGL() {
+	if (!loadGLExtensions()) {
+		std::cerr << "OpenGL 2.0 is not available, falling back to fixed-function rendering" << std::endl;
+	}
+
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_POINT_SMOOTH);
 	glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
@@ -8,10 +8,19 @@
 #include "SolarSystem.h"
 #include "BlackHole.h"
 #include "GalacticGas.h"
+#include "GalaxyBuilder.h"
+#include "ThreadPool.h"
+#include "OrbitKernels.h"
 #include "Input.h"
 #include "UI.h"
+#include "OfflineRender.h"
+#include "FrameCapture.h"
+#include "SelfTest.h"
+#include <cstring>
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#endif
 
 int WIDTH = 1920;
 int HEIGHT = 1080;
@@ -32,8 +41,7 @@ GalaxyConfig createDefaultGalaxyConfig() {
 	config.seed = rd();
 
 	config.rotationSpeed = 1.0;
-
-	std::cout << "Galaxy seed: " << config.seed << std::endl;
+	config.numThreads = 0;
 
 	return config;
 }
@@ -41,22 +49,23 @@ GalaxyConfig createDefaultGalaxyConfig() {
 BlackHoleConfig createDefaultBlackHoleConfig() {
 	BlackHoleConfig config;
 	config.enableSupermassive = true;
+	config.supermassiveMass = g_currentBlackHoleMass;
 
 	return config;
 }
 
-void render(const std::vector<Star>& stars, const std::vector<BlackHole>& blackHoles,
-	const std::vector<GasCloud>& gasClouds, const Camera& camera, UIState& uiState) {
+void render(const StarField& stars, const std::vector<BlackHole>& blackHoles,
+	const std::vector<GasCloud>& gasClouds, double simulationTime, const Camera& camera, UIState& uiState) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	setupCamera(camera, WIDTH, HEIGHT, solarSystem);
 
 	RenderZone zone = calculateRenderZone(camera);
 
-	renderStars(stars, zone);
+	renderStars(stars, simulationTime, zone);
 
-	renderGalacticGas(gasClouds, zone);
-	renderBlackHoles(blackHoles, zone);
+	renderGalacticGas(gasClouds, simulationTime, zone);
+	renderBlackHoles(blackHoles, simulationTime, zone);
 
 	if (solarSystem.isGenerated) {
 		renderSolarSystem(zone);
@@ -65,6 +74,7 @@ void render(const std::vector<Star>& stars, const std::vector<BlackHole>& blackH
 	renderUI(uiState, WIDTH, HEIGHT);
 }
 
+#ifdef _WIN32
 static bool check_linux() {
 	HMODULE ntdll = GetModuleHandle(L"ntdll.dll");
 
@@ -75,15 +85,43 @@ static bool check_linux() {
 
 	return (wine_get_version) ? true : false;
 }
+#endif
+
+int main(int argc, char** argv) {
+	// --self-test checks the numerical shortcuts against their references and exits
+	if (wantsSelfTest(argc, argv)) return runSelfTests();
+
+	// offline renders need no window or GPU, so they run anywhere
+	if (wantsOfflineRender(argc, argv)) {
+		OfflineRenderOptions options;
+		if (!parseOfflineRenderOptions(argc, argv, options)) return -1;
+		return runOfflineRender(options, createDefaultGalaxyConfig(), createDefaultGasConfig(),
+			createDefaultBlackHoleConfig());
+	}
 
-int main() {
+#ifdef _WIN32
 	if (check_linux()) {
 		MessageBoxA(NULL, "Linux is not supported.", "untitled Galaxy sim", MB_ICONERROR);
 		return -1;
 	}
+#endif
 
 	srand(static_cast<unsigned int>(time(nullptr)));
 
+	// F9 starts and stops recording the window, --capture name_%05d.png starts it right away;
+	// --gas-resolution 2 or 4 draws the gas at half or a quarter of the window's resolution
+	std::string capturePattern = "capture_%05d.png";
+	bool captureFromStart = false;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (strcmp(argv[i], "--capture") == 0) {
+			capturePattern = argv[++i];
+			captureFromStart = true;
+		}
+		else if (strcmp(argv[i], "--gas-resolution") == 0) {
+			setGasResolutionDivisor(atoi(argv[++i]));
+		}
+	}
+
 	WindowConfig windowConfig = { WIDTH, HEIGHT, "untitled Galaxy sim" };
 	GLFWwindow* window = initWindow(windowConfig);
 	if (!window) {
@@ -92,6 +130,12 @@ int main() {
 
 	setupOpenGL();
 
+	// workers for the per-frame loops, started once for the whole run
+	startThreadPool(g_threadPool);
+	std::cout << "Orbit kernel: " << orbitKernelName(activeOrbitKernel()) << std::endl;
+	std::cout << "Star renderer: " << starRendererName() << std::endl;
+	std::cout << "Gas renderer: " << gasRendererName() << std::endl;
+
 	Camera camera;
 	camera.posY = 200.0;
 	camera.pitch = -0.2;
@@ -104,18 +148,17 @@ int main() {
 
 	// Generate galaxy
 	GalaxyConfig galaxyConfig = createDefaultGalaxyConfig();
-	std::vector<Star> stars;
-	generateStarField(stars, galaxyConfig);
-
+	std::cout << "Galaxy seed: " << galaxyConfig.seed << std::endl;
 	BlackHoleConfig blackHoleConfig = createDefaultBlackHoleConfig();
-	std::vector<BlackHole> blackHoles;
-	generateBlackHoles(blackHoles, blackHoleConfig, galaxyConfig.seed,
-		galaxyConfig.diskRadius, galaxyConfig.bulgeRadius);
-
 	GasConfig gasConfig = createDefaultGasConfig();
-	std::vector<GasCloud> gasClouds;
-	generateGalacticGas(gasClouds, gasConfig, galaxyConfig.seed,
-		galaxyConfig.diskRadius, galaxyConfig.bulgeRadius);
+
+	// the first galaxy is built up front, later ones in the background.
+	// it still goes through the builder, so later builds can extend it
+	GalaxyScene scene;
+	GalaxyBuilder galaxyBuilder;
+	startGalaxyBuild(galaxyBuilder, scene, galaxyConfig, gasConfig, blackHoleConfig);
+	waitForGalaxyBuild(galaxyBuilder);
+	swapFinishedGalaxy(galaxyBuilder, scene);
 
 	generateSolarSystem();
 
@@ -132,8 +175,15 @@ int main() {
 
 	setGlobalUIState(&uiState);
 
+	FrameCapture capture;
+	if (captureFromStart) startFrameCapture(capture, capturePattern);
+	bool captureKeyWasPressed = false;
+
 	double lastTime = glfwGetTime();
 
+	// stars, gas and black holes are evaluated at this time, nothing in the scene is integrated
+	double simulationTime = 0.0;
+
 	// Main loop
 	while (!glfwWindowShouldClose(window)) {
 		double currentTime = glfwGetTime();
@@ -141,10 +191,15 @@ int main() {
 		lastTime = currentTime;
 
 		double adjustedDeltaTime = deltaTime * g_currentTimeSpeed;
+		simulationTime += adjustedDeltaTime;
+
+		if (swapFinishedGalaxy(galaxyBuilder, scene)) {
+			std::cout << "Galaxy regenerated with new parameters" << std::endl;
+		}
+		else {
+			updateGalaxyPreview(galaxyBuilder, scene);
+		}
 
-		updateStarPositions(stars, adjustedDeltaTime);
-		updateBlackHoles(blackHoles, adjustedDeltaTime);
-		updateGalacticGas(gasClouds, adjustedDeltaTime);
 		updatePlanets(adjustedDeltaTime);
 
 		handleUIInput(window, uiState);
@@ -152,28 +207,35 @@ int main() {
 		if (uiState.needsRegeneration) {
 			applyUIChangesToConfigs(uiState, galaxyConfig, gasConfig, blackHoleConfig);
 
-			stars.clear();
-			generateStarField(stars, galaxyConfig);
-
-			blackHoles.clear();
-			generateBlackHoles(blackHoles, blackHoleConfig, galaxyConfig.seed,
-				galaxyConfig.diskRadius, galaxyConfig.bulgeRadius);
+			// pressing Apply again while building replaces the running job
+			startGalaxyBuild(galaxyBuilder, scene, galaxyConfig, gasConfig, blackHoleConfig);
 
-			gasClouds.clear();
-			generateGalacticGas(gasClouds, gasConfig, galaxyConfig.seed,
-				galaxyConfig.diskRadius, galaxyConfig.bulgeRadius);
-
-			std::cout << "Galaxy regenerated with new parameters" << std::endl;
 			uiState.needsRegeneration = false;
 		}
 
 		processInput(window, camera, &uiState);
-		render(stars, blackHoles, gasClouds, camera, uiState);
+		render(scene.stars, scene.blackHoles, scene.gasClouds, simulationTime, camera, uiState);
+
+		bool captureKeyPressed = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+		if (captureKeyPressed && !captureKeyWasPressed) {
+			if (capture.active) stopFrameCapture(capture);
+			else startFrameCapture(capture, capturePattern);
+		}
+		captureKeyWasPressed = captureKeyPressed;
+
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		captureFrame(capture, framebufferWidth, framebufferHeight);
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	cancelGalaxyBuild(galaxyBuilder);
+	stopFrameCapture(capture);
+	stopThreadPool(g_threadPool);
+	releaseStarRenderer();
+	releaseGasRenderer();
 	cleanup(window);
 	return 0;
 }